@@ -38,6 +38,7 @@
 #include <QSharedPointer>
 #include <QString>
 #include <QVariant>
+#include <atomic>
 #include <cstring>
 
 #define DUP(v) GFModuleStrDup(v)
@@ -46,6 +47,8 @@
 #define USECDUP(v) UnSecStrDup(v)
 #define QDUP(v) QStrDup(v)
 #define QSECDUP(v) QSecStrDup(v)
+#define BDUP(v) QByteArrayStrDup(v)
+#define UBDUP(v) UnStrDupBytes(v)
 
 #define LISTEN(event) GFModuleListenEvent(GFGetModuleID(), DUP(event))
 
@@ -132,13 +135,70 @@ inline void MLogInfo(const QString& s) { GFModuleLogInfo(s.toUtf8()); }
 inline void MLogWarn(const QString& s) { GFModuleLogWarn(s.toUtf8()); }
 inline void MLogError(const QString& s) { GFModuleLogError(s.toUtf8()); }
 
-#define LOG_DEBUG(format) MLogDebug(FormatString(QString(format)))
+/**
+ * @brief Debug messages are only formatted while this is set. It is on in
+ * debug builds, and in release builds when the GF_MODULE_DEBUG_LOG
+ * environment variable is set to a non-zero value.
+ *
+ * @return std::atomic_bool&
+ */
+inline auto MLogDebugEnabledFlag() -> std::atomic_bool& {
+#ifdef NDEBUG
+  static std::atomic_bool enabled(
+      qEnvironmentVariableIntValue("GF_MODULE_DEBUG_LOG") != 0);
+#else
+  static std::atomic_bool enabled(true);
+#endif
+  return enabled;
+}
+
+inline auto MLogDebugEnabled() -> bool {
+  return MLogDebugEnabledFlag().load(std::memory_order_relaxed);
+}
+
+inline void MLogSetDebugEnabled(bool enabled) {
+  MLogDebugEnabledFlag().store(enabled, std::memory_order_relaxed);
+}
+
+/**
+ * @brief at most limit bytes of a payload for a log line, with its full size
+ * appended when it was cut
+ *
+ * @param payload
+ * @param limit
+ * @return QString
+ */
+inline auto LogPayload(const QByteArray& payload, qsizetype limit = 256)
+    -> QString {
+  if (payload.size() <= limit) return QString::fromUtf8(payload);
+  return QString("%1... (%2 bytes)")
+      .arg(QString::fromUtf8(payload.constData(), static_cast<int>(limit)))
+      .arg(payload.size());
+}
+
+inline auto LogPayload(const QString& payload, qsizetype limit = 256)
+    -> QString {
+  if (payload.size() <= limit) return payload;
+  return QString("%1... (%2 chars)")
+      .arg(payload.left(static_cast<int>(limit)))
+      .arg(payload.size());
+}
+
+// arguments of debug messages are not evaluated while debug output is off
+#define LOG_DEBUG(format)                                             \
+  do {                                                                \
+    if (MLogDebugEnabled()) MLogDebug(FormatString(QString(format))); \
+  } while (0)
 #define LOG_INFO(format) MLogDebug(FormatString(QString(format)))
 #define LOG_WARN(format) MLogDebug(FormatString(QString(format)))
 #define LOG_ERROR(format) MLogDebug(FormatString(QString(format)))
 
-#define FLOG_DEBUG(format, ...) \
-  MLogDebug(FormatString(QString(format), __VA_ARGS__))
+#define FLOG_DEBUG(format, ...)                              \
+  do {                                                       \
+    if (MLogDebugEnabled()) {                                \
+      MLogDebug(FormatString(QString(format), __VA_ARGS__)); \
+    }                                                        \
+  } while (0)
 #define FLOG_INFO(format, ...) \
   MLogInfo(FormatString(QString(format), __VA_ARGS__))
 #define FLOG_WARN(format, ...) \
@@ -152,12 +212,38 @@ inline auto QSecStrDup(const QString& str) -> char* {
   return SECDUP(str.toUtf8());
 }
 
+/**
+ * @brief copy raw bytes into a NUL-terminated SDK string without a QString
+ * round trip, the bytes need not be NUL-terminated themselves
+ *
+ * @param b
+ * @return char*
+ */
+inline auto QByteArrayStrDup(const QByteArray& b) -> char* {
+  auto* p = static_cast<char*>(GFAllocateMemory(b.size() + 1));
+  if (b.size() > 0) memcpy(p, b.constData(), b.size());
+  p[b.size()] = '\0';
+  return p;
+}
+
 inline auto UnStrDup(const char* s) -> QString {
   auto q_s = QString::fromUtf8(s == nullptr ? "" : s);
   if (s != nullptr) GFFreeMemory(static_cast<void*>(const_cast<char*>(s)));
   return q_s;
 }
 
+/**
+ * @brief take over an SDK string as raw bytes, without decoding it
+ *
+ * @param s
+ * @return QByteArray
+ */
+inline auto UnStrDupBytes(const char* s) -> QByteArray {
+  QByteArray b(s == nullptr ? "" : s);
+  if (s != nullptr) GFFreeMemory(static_cast<void*>(const_cast<char*>(s)));
+  return b;
+}
+
 inline auto UnSecStrDup(const char* s) -> QString {
   auto q_s = QString::fromUtf8(s == nullptr ? "" : s);
   if (s != nullptr) GFSecFreeMemory(static_cast<void*>(const_cast<char*>(s)));
@@ -30,9 +30,129 @@
 
 #include <QRegularExpression>
 #include <QTimeZone>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 
+#include "EMailBase64.h"
 #include "GFModuleCommonUtils.hpp"
 
+namespace {
+
+// lets vmime decode straight into a QByteArray
+class QByteArrayOutputStream : public vmime::utility::outputStream {
+ public:
+  explicit QByteArrayOutputStream(QByteArray& buffer) : buffer_(buffer) {}
+
+  void flush() override {}
+
+ protected:
+  void writeImpl(const vmime::byte_t* const data,
+                 const size_t count) override {
+    buffer_.append(reinterpret_cast<const char*>(data),
+                   static_cast<qsizetype>(count));
+  }
+
+ private:
+  QByteArray& buffer_;
+};
+
+// Writes straight into a device. The first occurrence of a placeholder is
+// swapped for the replacement on the way; only the bytes that could still
+// be the start of the placeholder are held back.
+class QIODeviceOutputStream : public vmime::utility::outputStream {
+ public:
+  QIODeviceOutputStream(QIODevice& device, const QByteArray& placeholder,
+                        const QByteArray& replacement)
+      : device_(device),
+        placeholder_(placeholder),
+        replacement_(replacement),
+        replaced_(placeholder.isEmpty()) {}
+
+  void flush() override {}
+
+  /**
+   * @brief write out what was held back
+   *
+   * @return true if everything was written and the placeholder was found
+   * @return false
+   */
+  auto Finish() -> bool {
+    write_bytes(pending_.constData(), pending_.size());
+    pending_.resize(0);
+    return ok_ && replaced_;
+  }
+
+ protected:
+  void writeImpl(const vmime::byte_t* const data,
+                 const size_t count) override {
+    const auto* bytes = reinterpret_cast<const char*>(data);
+    if (replaced_) {
+      write_bytes(bytes, static_cast<qsizetype>(count));
+      return;
+    }
+
+    pending_.append(bytes, static_cast<qsizetype>(count));
+    const auto pos = pending_.indexOf(placeholder_);
+    if (pos >= 0) {
+      replaced_ = true;
+      write_bytes(pending_.constData(), pos);
+      write_bytes(replacement_.constData(), replacement_.size());
+      const auto rest = pos + placeholder_.size();
+      write_bytes(pending_.constData() + rest, pending_.size() - rest);
+      pending_.resize(0);
+      return;
+    }
+
+    const auto keep = placeholder_.size() - 1;
+    if (pending_.size() > keep) {
+      write_bytes(pending_.constData(), pending_.size() - keep);
+      pending_.remove(0, pending_.size() - keep);
+    }
+  }
+
+ private:
+  void write_bytes(const char* data, qsizetype size) {
+    if (ok_ && size > 0) ok_ = device_.write(data, size) == size;
+  }
+
+  QIODevice& device_;
+  const QByteArray& placeholder_;
+  const QByteArray& replacement_;
+  QByteArray pending_;
+  bool replaced_;
+  bool ok_ = true;
+};
+
+// header field names are case-insensitive (RFC 5322 1.2.2)
+auto IsFieldName(const std::string& name, const char* field) -> bool {
+  const auto length = std::strlen(field);
+  if (name.size() != length) return false;
+  return std::equal(name.begin(), name.end(), field, [](char a, char b) {
+    return std::tolower(static_cast<unsigned char>(a)) ==
+           std::tolower(static_cast<unsigned char>(b));
+  });
+}
+
+auto ToQDateTime(const vmime::datetime& value) -> QDateTime {
+  QDate date(value.getYear(), value.getMonth(), value.getDay());
+  QTime time(value.getHour(), value.getMinute(), value.getSecond());
+  QDateTime datetime(date, time);
+
+  int offset_sec = value.getZone() * 60;
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+  QTimeZone tz(offset_sec);
+  datetime.setTimeZone(tz);
+#else
+  datetime.setOffsetFromUtc(offset_sec);
+#endif
+
+  return datetime;
+}
+
+}  // namespace
+
 static const QRegularExpression kNameEmailStringRegex{
     R"(^\s*(.*)\s*<\s*([^<>@\s]+@[^<>@\s]+)\s*>\s*$)"};
 
@@ -55,6 +175,21 @@ auto FormatMailBox(const std::shared_ptr<vmime::mailbox>& m) -> QString {
   return address;
 }
 
+namespace {
+
+auto ToMailBoxList(const vmime::shared_ptr<vmime::addressList>& value)
+    -> QStringList {
+  QStringList mailboxes;
+  if (!value) return mailboxes;
+
+  for (const auto& mailbox : value->toMailboxList()->getMailboxList()) {
+    mailboxes.append(FormatMailBox(mailbox));
+  }
+  return mailboxes;
+}
+
+}  // namespace
+
 auto ExtractFieldValue(const vmime::shared_ptr<vmime::header>& header,
                        const QString& field_name) -> QString {
   auto field = header->getField(field_name.toStdString());
@@ -146,25 +281,48 @@ auto ExtractFieldValueDateTime(const vmime::shared_ptr<vmime::header>& header,
     return {};
   }
 
-  QDate date(field_value->getYear(), field_value->getMonth(),
-             field_value->getDay());
-  QTime time(field_value->getHour(), field_value->getMinute(),
-             field_value->getSecond());
-  field_value->getZone();
-
-  auto zone = field_value->getZone();
-  QDateTime datetime(date, time);
-
-  int offset_sec = zone * 60;
-
-#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
-  QTimeZone tz(offset_sec);
-  datetime.setTimeZone(tz);
-#else
-  datetime.setOffsetFromUtc(offset_sec);
-#endif
+  return ToQDateTime(*field_value);
+}
 
-  return datetime;
+void ExtractEMLMetaData(const vmime::shared_ptr<vmime::header>& header,
+                        EMailMetaData& meta_data) {
+  // like header->getField(), the first occurrence of a field wins
+  bool from = false;
+  bool to = false;
+  bool cc = false;
+  bool bcc = false;
+  bool subject = false;
+  bool date = false;
+
+  for (const auto& field : header->getFieldList()) {
+    const auto& name = field->getName();
+
+    if (!from && IsFieldName(name, vmime::fields::FROM)) {
+      from = true;
+      auto value = field->getValue<vmime::mailbox>();
+      if (value) meta_data.from = FormatMailBox(value);
+    } else if (!to && IsFieldName(name, vmime::fields::TO)) {
+      to = true;
+      meta_data.to = ToMailBoxList(field->getValue<vmime::addressList>());
+    } else if (!cc && IsFieldName(name, vmime::fields::CC)) {
+      cc = true;
+      meta_data.cc = ToMailBoxList(field->getValue<vmime::addressList>());
+    } else if (!bcc && IsFieldName(name, vmime::fields::BCC)) {
+      bcc = true;
+      meta_data.bcc = ToMailBoxList(field->getValue<vmime::addressList>());
+    } else if (!subject && IsFieldName(name, vmime::fields::SUBJECT)) {
+      subject = true;
+      auto value = field->getValue<vmime::text>();
+      if (value) {
+        meta_data.subject =
+            Q_SC(value->getConvertedText(vmime::charsets::UTF_8));
+      }
+    } else if (!date && IsFieldName(name, vmime::fields::DATE)) {
+      date = true;
+      auto value = field->getValue<vmime::datetime>();
+      if (value) meta_data.datetime = ToQDateTime(*value);
+    }
+  }
 }
 
 auto ParseEmailString(const QString& input, QString& name, QString& email)
@@ -182,33 +340,106 @@ auto ParseEmailString(const QString& input, QString& name, QString& email)
 
 auto EncodeBase64WithLineBreaks(const QByteArray& data, int line_length)
     -> QString {
-  // Get the Base64 encoded data
-  QByteArray base64_data = data.toBase64();
-
-  // Split the base64 data into lines of the given line length
-  QStringList lines;
-  for (int i = 0; i < base64_data.size(); i += line_length) {
-    lines.append(base64_data.mid(i, line_length));
-  }
+  // lines and CRLF breaks are written into one buffer
+  return QString::fromLatin1(Base64Encode(data, line_length));
+}
 
-  // Join lines with CRLF
-  return lines.join("\r\n");
+auto FindEMLHeaderEnd(const QByteArray& data) -> qsizetype {
+  auto end = data.indexOf("\n\n");
+  const auto crlf_end = data.indexOf("\r\n\r\n");
+  if (crlf_end >= 0 && (end < 0 || crlf_end < end)) end = crlf_end;
+  return end < 0 ? data.size() : end;
 }
 
 auto CheckIfEMLMessage(const QByteArray& data,
                        vmime::shared_ptr<vmime::message>& message) -> bool {
-  vmime::string vmime_data(data.constData(), data.size());
+  // only the header block is parsed here, large bodies are left to
+  // ParseEMLBody once an operation needs them
+  vmime::string vmime_header(data.constData(), FindEMLHeaderEnd(data));
 
   message = vmime::make_shared<vmime::message>();
   try {
-    message->parse(vmime_data);
-    return message->getParsedLength() != 0 && !message->getHeader()->isEmpty();
+    message->getHeader()->parse(vmime_header);
+    return !message->getHeader()->isEmpty();
+  } catch (const vmime::exception& e) {
+    FLOG_DEBUG("error occurred when parsing vmime data: %1", e.what());
+    return false;
+  }
+}
+
+auto ParseEMLBody(const QByteArray& data,
+                  const vmime::shared_ptr<vmime::message>& message,
+                  QString& error_string) -> bool {
+  try {
+    ParseEMLMessageInPlace(data, message);
+    return true;
   } catch (const vmime::exception& e) {
     FLOG_DEBUG("error occurred when parsing vmime data: %1", e.what());
+    error_string = QString("VMIME Error: %1").arg(e.what());
     return false;
   }
 }
 
+void ParseEMLMessageInPlace(const QByteArray& data,
+                            const vmime::shared_ptr<vmime::message>& message) {
+  auto input_stream =
+      vmime::make_shared<vmime::utility::inputStreamByteBufferAdapter>(
+          reinterpret_cast<const vmime::byte_t*>(data.constData()),
+          static_cast<size_t>(data.size()));
+  message->parse(input_stream, static_cast<size_t>(data.size()));
+}
+
+auto GenerateEMLBytes(const vmime::component& component,
+                      size_t max_line_length) -> QByteArray {
+  QByteArray bytes;
+  QByteArrayOutputStream os(bytes);
+  component.generate(os, max_line_length);
+  return bytes;
+}
+
+auto GenerateEMLTo(const vmime::component& component, QIODevice& device,
+                   size_t max_line_length, const QByteArray& placeholder,
+                   const QByteArray& replacement) -> bool {
+  QIODeviceOutputStream os(device, placeholder, replacement);
+  component.generate(os, max_line_length);
+  return os.Finish();
+}
+
+auto ExtractRawBytes(const vmime::contentHandler& content) -> QByteArray {
+  QByteArray bytes;
+  QByteArrayOutputStream os(bytes);
+  content.extractRaw(os);
+  return bytes;
+}
+
+auto ExtractPublicKeyAttachments(
+    const vmime::shared_ptr<const vmime::bodyPart>& part, QByteArray& keys)
+    -> int {
+  int count = 0;
+  QByteArrayOutputStream os(keys);
+  for (const auto& att :
+       vmime::attachmentHelper::findAttachmentsInBodyPart(part)) {
+    if (Q_SC(att->getType().generate()).trimmed() != "application/pgp-keys") {
+      continue;
+    }
+
+    if (!keys.isEmpty() && !keys.endsWith('\n')) keys.append('\n');
+    att->getData()->extract(os);
+    count++;
+  }
+  return count;
+}
+
+auto ByteArrayView(const QByteArray& data, size_t offset, size_t length)
+    -> QByteArray {
+  const auto size = static_cast<size_t>(data.size());
+  if (offset >= size) return {};
+
+  length = std::min(length, size - offset);
+  return QByteArray::fromRawData(data.constData() + offset,
+                                 static_cast<qsizetype>(length));
+}
+
 auto BuildPlainTextEML(const EMailMetaData& meta_data,
                        const QByteArray& body_data, QString& eml_data) -> int {
   auto from = meta_data.from;
@@ -311,33 +542,6 @@ auto GetMetaData(QByteArray& data, EMailMetaData& meta_data) {}
 
 auto GetEMLMetaData(vmime::shared_ptr<vmime::message>& message,
                     EMailMetaData& meta_data) -> int {
-  auto header = message->getHeader();
-
-  auto from_field_value_text =
-      ExtractFieldValueMailBox(header, vmime::fields::FROM);
-  auto to_field_value_text =
-      ExtractFieldValueAddressList(header, vmime::fields::TO);
-  auto cc_field_value_text =
-      ExtractFieldValueAddressList(header, vmime::fields::CC);
-  auto bcc_field_value_text =
-      ExtractFieldValueAddressList(header, vmime::fields::BCC);
-  auto date_field_value =
-      ExtractFieldValueDateTime(header, vmime::fields::DATE);
-  auto subject_field_value_text =
-      ExtractFieldValueText(header, vmime::fields::SUBJECT);
-  auto reply_to_field_value_text =
-      ExtractFieldValueMailBox(header, vmime::fields::REPLY_TO);
-  auto organization_text =
-      ExtractFieldValueText(header, vmime::fields::ORGANIZATION);
-
-  meta_data.from = from_field_value_text;
-  meta_data.to = to_field_value_text.split(',');
-  meta_data.cc = cc_field_value_text.trimmed().isEmpty()
-                     ? QStringList()
-                     : cc_field_value_text.split(',');
-  meta_data.bcc = bcc_field_value_text.trimmed().isEmpty()
-                      ? QStringList()
-                      : bcc_field_value_text.split(',');
-  meta_data.subject = subject_field_value_text;
+  ExtractEMLMetaData(message->getHeader(), meta_data);
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,105 @@
+/**
+ * Copyright (C) 2021-2026 Saturneric <eric@bktus.com>
+ *
+ * This file is part of GpgFrontend.
+ *
+ * GpgFrontend is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GpgFrontend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GpgFrontend. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The initial version of the source code is inherited from
+ * the gpg4usb project, which is under GPL-3.0-or-later.
+ *
+ * All the source code of GpgFrontend was modified and released by
+ * Saturneric <eric@bktus.com> starting on May 12, 2021.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "EMailArena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "EMailModule.h"
+#include "GFModuleCommonUtils.hpp"
+
+namespace {
+
+thread_local std::shared_ptr<EMailArena> current_arena;
+
+void UpsertArenaCounter(const QString& operation, const char* counter,
+                        size_t value) {
+  const auto key = QString("email.arena.%1.%2")
+                       .arg(QString(operation).replace(' ', '_'),
+                            QString::fromLatin1(counter));
+  GFModuleUpsertRTValue(GFGetModuleID(), QDUP(key),
+                        QDUP(QString::number(value)));
+}
+
+}  // namespace
+
+EMailArena::~EMailArena() = default;
+
+auto EMailArena::Allocate(size_t size, size_t alignment) -> void* {
+  auto padding = [&]() -> size_t {
+    auto misalignment = reinterpret_cast<uintptr_t>(current_) % alignment;
+    return misalignment == 0 ? 0 : alignment - misalignment;
+  };
+
+  if (current_ == nullptr || padding() + size > left_) {
+    // requests larger than a block get a block sized to fit
+    const auto block_size = std::max(kBlockSize, size + alignment);
+    blocks_.emplace_back(new char[block_size]);
+    current_ = blocks_.back().get();
+    left_ = block_size;
+  }
+
+  auto* p = current_ + padding();
+  left_ -= (p - current_) + size;
+  current_ = p + size;
+
+  allocations_++;
+  bytes_ += size;
+  return p;
+}
+
+auto EMailArena::Allocations() const -> size_t { return allocations_; }
+
+auto EMailArena::Blocks() const -> size_t { return blocks_.size(); }
+
+auto EMailArena::Bytes() const -> size_t { return bytes_; }
+
+EMailArenaScope::EMailArenaScope(QString operation)
+    : operation_(std::move(operation)),
+      arena_(std::make_shared<EMailArena>()),
+      previous_(std::move(current_arena)) {
+  current_arena = arena_;
+}
+
+EMailArenaScope::~EMailArenaScope() {
+  current_arena = std::move(previous_);
+
+  FLOG_DEBUG("email arena %1: %2 allocations in %3 blocks, %4 bytes",
+             operation_, arena_->Allocations(), arena_->Blocks(),
+             arena_->Bytes());
+
+  // the counters of the last run of each operation, also in release builds
+  UpsertArenaCounter(operation_, "allocations", arena_->Allocations());
+  UpsertArenaCounter(operation_, "blocks", arena_->Blocks());
+  UpsertArenaCounter(operation_, "bytes", arena_->Bytes());
+}
+
+auto EMailArenaScope::Current() -> std::shared_ptr<EMailArena> {
+  return current_arena;
+}
@@ -0,0 +1,182 @@
+/**
+ * Copyright (C) 2021-2026 Saturneric <eric@bktus.com>
+ *
+ * This file is part of GpgFrontend.
+ *
+ * GpgFrontend is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GpgFrontend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GpgFrontend. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The initial version of the source code is inherited from
+ * the gpg4usb project, which is under GPL-3.0-or-later.
+ *
+ * All the source code of GpgFrontend was modified and released by
+ * Saturneric <eric@bktus.com> starting on May 12, 2021.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <QString>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Bump allocator for the vmime object graph of one message build.
+ *
+ * Memory is taken from a few large blocks and released all at once when the
+ * last object allocated from it goes away; every object keeps the arena alive
+ * through its allocator, so a graph may outlive the operation that built it.
+ * Only the thread that owns the operation allocates from an arena.
+ */
+class EMailArena {
+ public:
+  EMailArena() = default;
+  ~EMailArena();
+
+  EMailArena(const EMailArena&) = delete;
+  auto operator=(const EMailArena&) -> EMailArena& = delete;
+
+  /**
+   * @brief
+   *
+   * @param size
+   * @param alignment
+   * @return void*
+   */
+  auto Allocate(size_t size, size_t alignment) -> void*;
+
+  /**
+   * @brief number of objects allocated so far
+   *
+   * @return size_t
+   */
+  [[nodiscard]] auto Allocations() const -> size_t;
+
+  /**
+   * @brief number of blocks taken from the heap so far
+   *
+   * @return size_t
+   */
+  [[nodiscard]] auto Blocks() const -> size_t;
+
+  /**
+   * @brief bytes handed out so far
+   *
+   * @return size_t
+   */
+  [[nodiscard]] auto Bytes() const -> size_t;
+
+ private:
+  static constexpr size_t kBlockSize = 16 * 1024;
+
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  char* current_ = nullptr;
+  size_t left_ = 0;
+  size_t allocations_ = 0;
+  size_t bytes_ = 0;
+};
+
+/**
+ * @brief std::allocator compatible handle to an arena, for allocate_shared
+ *
+ * @tparam T
+ */
+template <typename T>
+class EMailArenaAllocator {
+ public:
+  using value_type = T;
+
+  explicit EMailArenaAllocator(std::shared_ptr<EMailArena> arena)
+      : arena_(std::move(arena)) {}
+
+  template <typename U>
+  EMailArenaAllocator(const EMailArenaAllocator<U>& other)  // NOLINT
+      : arena_(other.arena_) {}
+
+  auto allocate(size_t n) -> T* {
+    return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+  }
+
+  // released with the arena
+  void deallocate(T*, size_t) {}
+
+  template <typename U>
+  auto operator==(const EMailArenaAllocator<U>& other) const -> bool {
+    return arena_ == other.arena_;
+  }
+
+  template <typename U>
+  auto operator!=(const EMailArenaAllocator<U>& other) const -> bool {
+    return arena_ != other.arena_;
+  }
+
+ private:
+  template <typename U>
+  friend class EMailArenaAllocator;
+
+  std::shared_ptr<EMailArena> arena_;
+};
+
+/**
+ * @brief Makes EMailMakeShared() allocate from a fresh arena on this thread
+ * until the end of the scope, then logs how many objects the operation
+ * allocated and publishes the counts as the runtime values
+ * "email.arena.<operation>.allocations", ".blocks" and ".bytes", spaces in
+ * the operation name replaced by '_'.
+ *
+ */
+class EMailArenaScope {
+ public:
+  /**
+   * @brief
+   *
+   * @param operation
+   */
+  explicit EMailArenaScope(QString operation);
+
+  ~EMailArenaScope();
+
+  EMailArenaScope(const EMailArenaScope&) = delete;
+  auto operator=(const EMailArenaScope&) -> EMailArenaScope& = delete;
+
+  /**
+   * @brief arena of the innermost scope on this thread, if any
+   *
+   * @return std::shared_ptr<EMailArena>
+   */
+  static auto Current() -> std::shared_ptr<EMailArena>;
+
+ private:
+  QString operation_;
+  std::shared_ptr<EMailArena> arena_;
+  std::shared_ptr<EMailArena> previous_;
+};
+
+/**
+ * @brief vmime::make_shared, but from the arena of the current
+ * EMailArenaScope when there is one
+ *
+ * @tparam T
+ * @tparam Args
+ * @param args
+ * @return std::shared_ptr<T>
+ */
+template <typename T, typename... Args>
+auto EMailMakeShared(Args&&... args) -> std::shared_ptr<T> {
+  auto arena = EMailArenaScope::Current();
+  if (arena == nullptr) return std::make_shared<T>(std::forward<Args>(args)...);
+  return std::allocate_shared<T>(EMailArenaAllocator<T>(std::move(arena)),
+                                 std::forward<Args>(args)...);
+}
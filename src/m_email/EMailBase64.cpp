@@ -0,0 +1,366 @@
+/**
+ * Copyright (C) 2021-2026 Saturneric <eric@bktus.com>
+ *
+ * This file is part of GpgFrontend.
+ *
+ * GpgFrontend is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GpgFrontend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GpgFrontend. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The initial version of the source code is inherited from
+ * the gpg4usb project, which is under GPL-3.0-or-later.
+ *
+ * All the source code of GpgFrontend was modified and released by
+ * Saturneric <eric@bktus.com> starting on May 12, 2021.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "EMailBase64.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define EMAIL_BASE64_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr char kEncodeTable[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+constexpr uint8_t kInvalid = 0xFF;
+
+constexpr auto kDecodeTable = []() {
+  std::array<uint8_t, 256> table{};
+  for (auto& v : table) v = kInvalid;
+  for (uint8_t i = 0; i < 64; i++) {
+    table[static_cast<uint8_t>(kEncodeTable[i])] = i;
+  }
+  return table;
+}();
+
+auto EncodeScalar(const uint8_t* in, size_t len, char* out) -> size_t {
+  char* o = out;
+  size_t i = 0;
+  for (; i + 3 <= len; i += 3) {
+    const uint32_t v = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+    *o++ = kEncodeTable[v >> 18];
+    *o++ = kEncodeTable[(v >> 12) & 0x3F];
+    *o++ = kEncodeTable[(v >> 6) & 0x3F];
+    *o++ = kEncodeTable[v & 0x3F];
+  }
+
+  if (len - i == 1) {
+    const uint32_t v = in[i] << 16;
+    *o++ = kEncodeTable[v >> 18];
+    *o++ = kEncodeTable[(v >> 12) & 0x3F];
+    *o++ = '=';
+    *o++ = '=';
+  } else if (len - i == 2) {
+    const uint32_t v = (in[i] << 16) | (in[i + 1] << 8);
+    *o++ = kEncodeTable[v >> 18];
+    *o++ = kEncodeTable[(v >> 12) & 0x3F];
+    *o++ = kEncodeTable[(v >> 6) & 0x3F];
+    *o++ = '=';
+  }
+  return o - out;
+}
+
+#ifdef EMAIL_BASE64_X86_SIMD
+
+// The vector kernels follow Wojciech Muła's base64 algorithms: a byte shuffle
+// spreads every 3 input bytes over 4 lanes, multiplies move the 6-bit fields
+// into place and a small lookup by value range maps them to ASCII. Decoding
+// runs the same steps backwards and leaves a block to the scalar code as soon
+// as it contains a character outside the alphabet.
+
+auto HasAVX2() -> bool {
+  static const bool kHas = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+  }();
+  return kHas;
+}
+
+auto HasSSSE3() -> bool {
+  static const bool kHas = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3") != 0;
+  }();
+  return kHas;
+}
+
+__attribute__((target("ssse3"))) auto EncodeBlockSSSE3(__m128i in)
+    -> __m128i {
+  in = _mm_shuffle_epi8(
+      in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  const auto t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+  const auto t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+  const auto t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+  const auto t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+  const auto indices = _mm_or_si128(t1, t3);
+
+  const auto lut = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4,
+                                 -4, -19, -16, 0, 0);
+  auto offsets = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  offsets = _mm_sub_epi8(offsets,
+                         _mm_cmpgt_epi8(indices, _mm_set1_epi8(25)));
+  return _mm_add_epi8(indices, _mm_shuffle_epi8(lut, offsets));
+}
+
+__attribute__((target("ssse3"))) auto EncodeSSSE3(const uint8_t* in,
+                                                  size_t len, char* out)
+    -> size_t {
+  size_t i = 0;
+  // 16 bytes are loaded for every 12 consumed
+  for (; i + 16 <= len; i += 12) {
+    const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i / 3 * 4),
+                     EncodeBlockSSSE3(v));
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) auto EncodeAVX2(const uint8_t* in, size_t len,
+                                                char* out) -> size_t {
+  // the low lane takes its 12 bytes at offset 4, so every load starts 4
+  // bytes early; the first two groups are done in scalar code to allow that
+  if (len < 34) return 0;
+  size_t i = 6;
+  EncodeScalar(in, i, out);
+
+  const auto shuffle = _mm256_set_epi8(
+      10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,  //
+      14, 15, 13, 14, 11, 12, 10, 11, 8, 9, 7, 8, 5, 6, 4, 5);
+  const auto lut = _mm256_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4,
+                                    -4, -4, -19, -16, 0, 0, 65, 71, -4, -4,
+                                    -4, -4, -4, -4, -4, -4, -4, -4, -19, -16,
+                                    0, 0);
+
+  for (; i + 28 <= len; i += 24) {
+    auto v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i - 4));
+    v = _mm256_shuffle_epi8(v, shuffle);
+    const auto t0 = _mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00));
+    const auto t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    const auto t2 = _mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0));
+    const auto t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+    const auto indices = _mm256_or_si256(t1, t3);
+
+    auto offsets = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+    offsets = _mm256_sub_epi8(
+        offsets, _mm256_cmpgt_epi8(indices, _mm256_set1_epi8(25)));
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i*>(out + i / 3 * 4),
+        _mm256_add_epi8(indices, _mm256_shuffle_epi8(lut, offsets)));
+  }
+  return i;
+}
+
+__attribute__((target("ssse3"))) auto DecodeSSSE3(const uint8_t* in,
+                                                  size_t len, uint8_t* out)
+    -> size_t {
+  const auto lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                    0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B,
+                                    0x1B, 0x1A);
+  const auto lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04,
+                                    0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                    0x10, 0x10);
+  const auto lut_roll =
+      _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const auto mask_2f = _mm_set1_epi8(0x2f);
+
+  size_t i = 0;
+  // 16 bytes are stored for every 12 produced
+  for (; i + 16 <= len; i += 16) {
+    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    const auto hi_nibbles = _mm_and_si128(_mm_srli_epi32(v, 4), mask_2f);
+    const auto lo_nibbles = _mm_and_si128(v, mask_2f);
+    const auto hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+    const auto lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+    if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi),
+                                         _mm_setzero_si128())) != 0) {
+      break;
+    }
+
+    const auto eq_2f = _mm_cmpeq_epi8(v, mask_2f);
+    v = _mm_add_epi8(
+        v, _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles)));
+
+    v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+    v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+    v = _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13,
+                                          12, -1, -1, -1, -1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i / 4 * 3), v);
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) auto DecodeAVX2(const uint8_t* in, size_t len,
+                                                uint8_t* out) -> size_t {
+  const auto lut_lo = _mm256_setr_epi8(
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A,
+      0x1B, 0x1B, 0x1B, 0x1A, 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+      0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+  const auto lut_hi = _mm256_setr_epi8(
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const auto lut_roll = _mm256_setr_epi8(
+      0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,  //
+      0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const auto mask_2f = _mm256_set1_epi8(0x2f);
+
+  size_t i = 0;
+  // 32 bytes are stored for every 24 produced
+  for (; i + 32 <= len; i += 32) {
+    auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+    const auto hi_nibbles =
+        _mm256_and_si256(_mm256_srli_epi32(v, 4), mask_2f);
+    const auto lo_nibbles = _mm256_and_si256(v, mask_2f);
+    const auto hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+    const auto lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+    if (_mm256_testz_si256(lo, hi) == 0) break;
+
+    const auto eq_2f = _mm256_cmpeq_epi8(v, mask_2f);
+    v = _mm256_add_epi8(
+        v, _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles)));
+
+    v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+    v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+    v = _mm256_shuffle_epi8(
+        v, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1,
+                            -1, 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1,
+                            -1, -1));
+    v = _mm256_permutevar8x32_epi32(v,
+                                    _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i / 4 * 3), v);
+  }
+  return i;
+}
+
+#endif
+
+auto Encode(const uint8_t* in, size_t len, char* out) -> size_t {
+  size_t done = 0;
+#ifdef EMAIL_BASE64_X86_SIMD
+  if (HasAVX2()) {
+    done = EncodeAVX2(in, len, out);
+  } else if (HasSSSE3()) {
+    done = EncodeSSSE3(in, len, out);
+  }
+#endif
+  return done / 3 * 4 + EncodeScalar(in + done, len - done, out + done / 3 * 4);
+}
+
+// out needs room for len / 4 * 3 + 32 bytes, vector stores overshoot
+auto Decode(const uint8_t* in, size_t len, uint8_t* out) -> size_t {
+  uint8_t* o = out;
+  uint32_t bits = 0;
+  int n_bits = 0;
+
+  size_t i = 0;
+#ifdef EMAIL_BASE64_X86_SIMD
+  size_t scalar_until = 0;
+#endif
+  while (i < len) {
+#ifdef EMAIL_BASE64_X86_SIMD
+    // vector blocks have to start on a group boundary
+    if (n_bits == 0 && i >= scalar_until) {
+      size_t done = 0;
+      if (HasAVX2()) {
+        done = DecodeAVX2(in + i, len - i, o);
+      } else if (HasSSSE3()) {
+        done = DecodeSSSE3(in + i, len - i, o);
+      }
+      i += done;
+      o += done / 4 * 3;
+
+      // the next block holds a line break or padding, step over it
+      scalar_until = i + 32;
+      if (i >= len) break;
+    }
+#endif
+
+    const auto v = kDecodeTable[in[i++]];
+    if (v == kInvalid) continue;
+
+    bits = (bits << 6) | v;
+    n_bits += 6;
+    if (n_bits >= 8) {
+      n_bits -= 8;
+      *o++ = static_cast<uint8_t>(bits >> n_bits);
+    }
+  }
+  return o - out;
+}
+
+}  // namespace
+
+auto Base64Encode(const QByteArray& data, int line_length) -> QByteArray {
+  const auto* in = reinterpret_cast<const uint8_t*>(data.constData());
+  const auto len = static_cast<size_t>(data.size());
+  const size_t encoded_len = (len + 2) / 3 * 4;
+
+  if (line_length <= 0 || encoded_len <= static_cast<size_t>(line_length)) {
+    QByteArray out(static_cast<qsizetype>(encoded_len), Qt::Uninitialized);
+    Encode(in, len, out.data());
+    return out;
+  }
+
+  const auto line = static_cast<size_t>(line_length);
+  const size_t lines = (encoded_len + line - 1) / line;
+  QByteArray out(static_cast<qsizetype>(encoded_len + (lines - 1) * 2),
+                 Qt::Uninitialized);
+  char* o = out.data();
+
+  if (line % 4 == 0) {
+    // every line holds whole groups and is encoded in place
+    const size_t line_input = line / 4 * 3;
+    for (size_t i = 0; i < len; i += line_input) {
+      if (i != 0) {
+        *o++ = '\r';
+        *o++ = '\n';
+      }
+      o += Encode(in + i, std::min(line_input, len - i), o);
+    }
+    return out;
+  }
+
+  // move the lines apart back to front to make room for the line breaks
+  Encode(in, len, o);
+  for (size_t l = lines - 1; l > 0; l--) {
+    std::memmove(o + l * (line + 2), o + l * line,
+                 std::min(line, encoded_len - l * line));
+    o[l * (line + 2) - 2] = '\r';
+    o[l * (line + 2) - 1] = '\n';
+  }
+  return out;
+}
+
+auto Base64Decode(const QByteArray& data) -> QByteArray {
+  const auto len = static_cast<size_t>(data.size());
+  QByteArray out(static_cast<qsizetype>(len / 4 * 3 + 32), Qt::Uninitialized);
+
+  const auto size =
+      Decode(reinterpret_cast<const uint8_t*>(data.constData()), len,
+             reinterpret_cast<uint8_t*>(out.data()));
+  out.truncate(static_cast<qsizetype>(size));
+  return out;
+}
@@ -0,0 +1,52 @@
+/**
+ * Copyright (C) 2021-2026 Saturneric <eric@bktus.com>
+ *
+ * This file is part of GpgFrontend.
+ *
+ * GpgFrontend is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GpgFrontend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GpgFrontend. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The initial version of the source code is inherited from
+ * the gpg4usb project, which is under GPL-3.0-or-later.
+ *
+ * All the source code of GpgFrontend was modified and released by
+ * Saturneric <eric@bktus.com> starting on May 12, 2021.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <QByteArray>
+
+/**
+ * @brief base64 encode data into one preallocated buffer. With line_length
+ * > 0 the output is broken into lines of that many characters, separated by
+ * CRLF. Uses AVX2 or SSSE3 when the CPU has them.
+ *
+ * @param data
+ * @param line_length
+ * @return QByteArray
+ */
+auto Base64Encode(const QByteArray& data, int line_length = 0) -> QByteArray;
+
+/**
+ * @brief base64 decode data. Like QByteArray::fromBase64, characters outside
+ * the alphabet (line breaks, padding) are skipped. Uses AVX2 or SSSE3 when the
+ * CPU has them.
+ *
+ * @param data
+ * @return QByteArray
+ */
+auto Base64Decode(const QByteArray& data) -> QByteArray;
@@ -33,164 +33,309 @@
 //
 #include <QCryptographicHash>
 
+#include "EMailArena.h"
+#include "EMailGpgChannel.h"
 #include "EMailHelper.h"
+#include "EMailKeyringCache.h"
+#include "EMailPGPMIMEScanner.h"
 #include "GFModuleCommonUtils.hpp"
 
-auto EncryptPlainText(int channel, const QStringList& keys,
-                      const EMailMetaData& meta_data,
-                      const QByteArray& body_data, QString& eml_data,
-                      gpgme_error_t& err, QString& capsule_id) -> int {
-  auto from = meta_data.from;
-  auto recipient_list = meta_data.to;
-  auto cc_list = meta_data.cc;
-  auto bcc_list = meta_data.bcc;
-  auto subject = meta_data.subject;
+auto GenerateEMLData(const vmime::shared_ptr<vmime::message>& message,
+                     QString& eml_data) -> int {
+  try {
+    eml_data = Q_SC(message->generate(vmime::lineLengthLimits::convenient));
+    FLOG_DEBUG("EML Data: %1", LogPayload(eml_data));
+    return kSUCCESS;
+  } catch (const vmime::exception& e) {
+    eml_data = QString("VMIME Error: %1").arg(e.what());
+    return kEML_FAILED;
+  }
+}
 
-  QString name;
-  QString email;
+namespace {
 
-  try {
-    GFGpgEncryptionResult* s = nullptr;
-    auto ret = GFGpgEncryptData(channel, QStringListToCharArray(keys),
-                                keys.size(), QDUP(body_data), 1, &s);
+// One GFGpgEncryptData call, error_string is set unless kSUCCESS.
+auto EncryptBytes(int channel, const QStringList& keys,
+                  const QByteArray& plain_raw_data, QByteArray& encrypted_data,
+                  gpgme_error_t& err, QString& capsule_id,
+                  QString& error_string) -> int {
+  GFGpgEncryptionResult* s = nullptr;
+  auto ret = WithGpgChannel(channel, [&]() {
+    return GFGpgEncryptData(channel, QStringListToCharArray(keys), keys.size(),
+                            BDUP(plain_raw_data), 1, &s);
+  });
 
-    auto encrypted_data = UDUP(s->encrypted_data);
-    err = s->gpgme_error;
-    capsule_id = UDUP(s->capsule_id);
-    auto gpg_error_string = UDUP(s->error_string);
+  encrypted_data = UBDUP(s->encrypted_data);
+  err = s->gpgme_error;
+  capsule_id = UDUP(s->capsule_id);
+  auto gpg_error_string = UDUP(s->error_string);
 
-    GFGpgFreeResult(s->gpgme_encrypt_result);
-    GFFreeMemory(s);
+  GFGpgFreeResult(s->gpgme_encrypt_result);
+  GFFreeMemory(s);
 
-    if (ret != 0) {
-      eml_data = "Operation Failed.";
-      return kFAILED;
-    }
+  if (ret != 0) {
+    error_string = "Operation Failed";
+    return kFAILED;
+  }
 
-    if (err != GPG_ERR_NO_ERROR) {
-      eml_data = "Gpg Encryption Failed: " + gpg_error_string;
-      return kGPG_FAILED;
-    }
+  if (err != GPG_ERR_NO_ERROR) {
+    error_string = "Encryption Failed: " + gpg_error_string;
+    return kGPG_FAILED;
+  }
+  return kSUCCESS;
+}
 
-    vmime::messageBuilder msg_builder;
+// The outer message of an encrypted plain text, the subject is hidden.
+auto BuildPlainTextMessage(const EMailMetaData& meta_data)
+    -> vmime::shared_ptr<vmime::message> {
+  const auto& from = meta_data.from;
+  const auto& recipient_list = meta_data.to;
+  const auto& cc_list = meta_data.cc;
+  const auto& bcc_list = meta_data.bcc;
 
-    if (ParseEmailString(from, name, email)) {
-      msg_builder.setExpeditor(vmime::mailbox(email.toStdString()));
+  QString name;
+  QString email;
+
+  vmime::messageBuilder msg_builder;
+
+  if (ParseEmailString(from, name, email)) {
+    msg_builder.setExpeditor(vmime::mailbox(email.toStdString()));
+  } else {
+    msg_builder.setExpeditor(vmime::mailbox(from.toStdString()));
+  }
+
+  for (const QString& recipient : recipient_list) {
+    auto trimmed_recipient = recipient.trimmed();
+    if (ParseEmailString(trimmed_recipient, name, email)) {
+      msg_builder.getRecipients().appendAddress(
+          EMailMakeShared<vmime::mailbox>(email.toStdString()));
     } else {
-      msg_builder.setExpeditor(vmime::mailbox(from.toStdString()));
+      msg_builder.getRecipients().appendAddress(
+          EMailMakeShared<vmime::mailbox>(trimmed_recipient.toStdString()));
     }
+  }
 
-    for (const QString& recipient : recipient_list) {
-      auto trimmed_recipient = recipient.trimmed();
-      if (ParseEmailString(trimmed_recipient, name, email)) {
-        msg_builder.getRecipients().appendAddress(
-            vmime::make_shared<vmime::mailbox>(email.toStdString()));
-      } else {
-        msg_builder.getRecipients().appendAddress(
-            vmime::make_shared<vmime::mailbox>(
-                trimmed_recipient.toStdString()));
-      }
+  for (const QString& recipient : cc_list) {
+    auto trimmed_recipient = recipient.trimmed();
+    if (ParseEmailString(trimmed_recipient, name, email)) {
+      msg_builder.getCopyRecipients().appendAddress(
+          EMailMakeShared<vmime::mailbox>(email.toStdString()));
+    } else {
+      msg_builder.getCopyRecipients().appendAddress(
+          EMailMakeShared<vmime::mailbox>(trimmed_recipient.toStdString()));
     }
+  }
 
-    for (const QString& recipient : cc_list) {
-      auto trimmed_recipient = recipient.trimmed();
-      if (ParseEmailString(trimmed_recipient, name, email)) {
-        msg_builder.getCopyRecipients().appendAddress(
-            vmime::make_shared<vmime::mailbox>(email.toStdString()));
-      } else {
-        msg_builder.getCopyRecipients().appendAddress(
-            vmime::make_shared<vmime::mailbox>(
-                trimmed_recipient.toStdString()));
-      }
+  for (const QString& recipient : bcc_list) {
+    auto trimmed_recipient = recipient.trimmed();
+    if (ParseEmailString(trimmed_recipient, name, email)) {
+      msg_builder.getBlindCopyRecipients().appendAddress(
+          EMailMakeShared<vmime::mailbox>(email.toStdString()));
+    } else {
+      msg_builder.getBlindCopyRecipients().appendAddress(
+          EMailMakeShared<vmime::mailbox>(trimmed_recipient.toStdString()));
     }
+  }
 
-    for (const QString& recipient : bcc_list) {
-      auto trimmed_recipient = recipient.trimmed();
-      if (ParseEmailString(trimmed_recipient, name, email)) {
-        msg_builder.getBlindCopyRecipients().appendAddress(
-            vmime::make_shared<vmime::mailbox>(email.toStdString()));
-      } else {
-        msg_builder.getBlindCopyRecipients().appendAddress(
-            vmime::make_shared<vmime::mailbox>(
-                trimmed_recipient.toStdString()));
-      }
-    }
+  msg_builder.setSubject(vmime::text("..."));
 
-    msg_builder.setSubject(vmime::text("..."));
+  return msg_builder.construct();
+}
 
-    vmime::shared_ptr<vmime::message> msg = msg_builder.construct();
+// The plaintext that goes into the encryption: the body under a copy of the
+// header fields needed to render it, with CRLF line endings.
+auto BuildEncryptionPlainText(const vmime::shared_ptr<vmime::header>& header,
+                              const QByteArray& plain_body_signed_raw_data)
+    -> QByteArray {
+  auto backup_content_type_header_field_component =
+      header->getField<vmime::headerField>(vmime::fields::CONTENT_TYPE)
+          ->clone();
+
+  std::shared_ptr<vmime::headerField> backup_content_type_header_field =
+      std::static_pointer_cast<vmime::headerField>(
+          backup_content_type_header_field_component);
+
+  auto backup_from_field_component =
+      header->getField<vmime::headerField>(vmime::fields::FROM)->clone();
+
+  std::shared_ptr<vmime::headerField> backup_from_field =
+      std::static_pointer_cast<vmime::headerField>(backup_from_field_component);
+
+  auto backup_to_field_component =
+      header->getField<vmime::headerField>(vmime::fields::TO)->clone();
+
+  std::shared_ptr<vmime::headerField> backup_to_field =
+      std::static_pointer_cast<vmime::headerField>(backup_to_field_component);
+
+  auto backup_message_id_field_component =
+      header->hasField(vmime::fields::MESSAGE_ID)
+          ? header->getField<vmime::headerField>(vmime::fields::MESSAGE_ID)
+                ->clone()
+          : nullptr;
+
+  std::shared_ptr<vmime::headerField> backup_message_id_field =
+      std::static_pointer_cast<vmime::headerField>(
+          backup_message_id_field_component);
+
+  auto backup_subject_field_component =
+      header->getField<vmime::headerField>(vmime::fields::SUBJECT)->clone();
+
+  std::shared_ptr<vmime::headerField> backup_subject_field =
+      std::static_pointer_cast<vmime::headerField>(
+          backup_subject_field_component);
+
+  auto plain_part = EMailMakeShared<vmime::bodyPart>();
+  auto plain_part_header = plain_part->getHeader();
+  plain_part_header->appendField(backup_content_type_header_field);
+  plain_part_header->appendField(backup_subject_field);
+  plain_part_header->appendField(backup_from_field);
+  plain_part_header->appendField(backup_to_field);
+  if (backup_message_id_field != nullptr) {
+    plain_part_header->appendField(backup_message_id_field);
+  }
 
-    auto header = msg->getHeader();
+  auto plain_header_raw_data = GenerateEMLBytes(
+      *plain_part_header, vmime::lineLengthLimits::convenient);
 
-    // no Content-Transfer-Encoding
-    header->removeField(
-        header->getField(vmime::fields::CONTENT_TRANSFER_ENCODING));
+  auto plain_raw_data =
+      plain_header_raw_data + "\r\n" + plain_body_signed_raw_data;
 
-    auto content_type_header_field =
-        header->getField<vmime::contentTypeField>(vmime::fields::CONTENT_TYPE);
-    content_type_header_field->setValue("multipart/encrypted");
-    content_type_header_field->appendParameter(
-        vmime::make_shared<vmime::parameter>("protocol",
-                                             "application/pgp-encrypted"));
+  plain_raw_data.replace("\r\n", "\n");
+  plain_raw_data.replace("\n", "\r\n");
+  return plain_raw_data;
+}
 
-    auto root_part_boundary = vmime::body::generateRandomBoundaryString();
-    content_type_header_field->setBoundary(root_part_boundary);
+// The outer headers of a per-recipient copy: every copy shares them, so
+// none may name the Bcc recipients. To and Cc are replaced by an empty
+// group; the encrypted part still carries the original To.
+void NeutralizeRecipientHeaders(
+    const vmime::shared_ptr<vmime::header>& header) {
+  header->removeAllFields(vmime::fields::BCC);
+  header->removeAllFields(vmime::fields::CC);
+
+  vmime::addressList undisclosed;
+  undisclosed.appendAddress(EMailMakeShared<vmime::mailboxGroup>(
+      vmime::text("undisclosed-recipients")));
+  header->To()->setValue(undisclosed);
+}
 
-    auto root_body_part = vmime::make_shared<vmime::bodyPart>();
-    auto control_info_part = vmime::make_shared<vmime::bodyPart>();
-    auto encrypted_data_part = vmime::make_shared<vmime::bodyPart>();
+// Turns the message into the multipart/encrypted envelope around the
+// armored data, hiding the subject.
+void BuildEncryptedEnvelope(const vmime::shared_ptr<vmime::message>& message,
+                            const std::string& encrypted_data) {
+  auto header = message->getHeader();
 
-    root_body_part->getBody()->appendPart(control_info_part);
-    root_body_part->getBody()->appendPart(encrypted_data_part);
-    root_body_part->getBody()->setPrologText(
-        "This is an OpenPGP/MIME encrypted message (RFC 4880 and 3156)");
-    msg->setBody(root_body_part->getBody());
+  // no Content-Transfer-Encoding
+  header->removeField(
+      header->getField(vmime::fields::CONTENT_TRANSFER_ENCODING));
 
-    auto control_info_part_header = control_info_part->getHeader();
-    auto control_info_content_type_field =
-        control_info_part_header->getField<vmime::contentTypeField>(
-            vmime::fields::CONTENT_TYPE);
-    control_info_content_type_field->setValue("application/pgp-encrypted");
+  auto content_type_header_field =
+      header->getField<vmime::contentTypeField>(vmime::fields::CONTENT_TYPE);
+  content_type_header_field->setValue("multipart/encrypted");
+  content_type_header_field->appendParameter(
+      EMailMakeShared<vmime::parameter>("protocol",
+                                        "application/pgp-encrypted"));
+
+  // hide subject
+  header->Subject()->setValue("...");
+
+  auto root_part_boundary = vmime::body::generateRandomBoundaryString();
+  content_type_header_field->setBoundary(root_part_boundary);
+
+  auto root_body_part = EMailMakeShared<vmime::bodyPart>();
+  auto control_info_part = EMailMakeShared<vmime::bodyPart>();
+  auto encrypted_data_part = EMailMakeShared<vmime::bodyPart>();
+
+  root_body_part->getBody()->appendPart(control_info_part);
+  root_body_part->getBody()->appendPart(encrypted_data_part);
+  root_body_part->getBody()->setPrologText(
+      "This is an OpenPGP/MIME encrypted message (RFC 4880 and 3156)");
+  message->setBody(root_body_part->getBody());
+
+  auto control_info_part_header = control_info_part->getHeader();
+  auto control_info_content_type_field =
+      control_info_part_header->getField<vmime::contentTypeField>(
+          vmime::fields::CONTENT_TYPE);
+  control_info_content_type_field->setValue("application/pgp-encrypted");
+
+  auto control_info_part_content_desc_header_field =
+      control_info_part_header->getField(vmime::fields::CONTENT_DESCRIPTION);
+  control_info_part_content_desc_header_field->setValue(
+      "PGP/MIME version identification");
+
+  auto control_info_body = control_info_part->getBody();
+  auto control_info_content =
+      EMailMakeShared<vmime::stringContentHandler>("Version: 1");
+  control_info_body->setContents(control_info_content);
+
+  auto encrypted_data_part_header = encrypted_data_part->getHeader();
+  auto encrypted_data_content_type_field =
+      encrypted_data_part_header->getField<vmime::contentTypeField>(
+          vmime::fields::CONTENT_TYPE);
+  encrypted_data_content_type_field->setValue("application/octet-stream");
+  encrypted_data_content_type_field->appendParameter(
+      EMailMakeShared<vmime::parameter>("name", "encrypted.asc"));
+
+  auto encrypted_data_content_desc_header_field =
+      encrypted_data_part_header->getField(vmime::fields::CONTENT_DESCRIPTION);
+  encrypted_data_content_desc_header_field->setValue(
+      "OpenPGP encrypted message");
+
+  auto encrypted_data_content_disp_header_field =
+      encrypted_data_part_header->getField<vmime::contentDispositionField>(
+          vmime::fields::CONTENT_DISPOSITION);
+  encrypted_data_content_disp_header_field->setValue("inline");
+  encrypted_data_content_disp_header_field->setFilename(
+      vmime::word(std::string{"encrypted.asc"}));
+
+  auto encrypted_data_body = encrypted_data_part->getBody();
+  auto encrypted_data_content =
+      EMailMakeShared<vmime::stringContentHandler>(encrypted_data);
+  encrypted_data_body->setContents(encrypted_data_content);
+}
 
-    auto control_info_part_content_desc_header_field =
-        control_info_part_header->getField(vmime::fields::CONTENT_DESCRIPTION);
-    control_info_part_content_desc_header_field->setValue(
-        "PGP/MIME version identification");
+// Stands in for the armored data while the envelope is generated, see
+// WriteEncryptedEnvelope and EncryptEMLDataPerRecipient.
+auto EncryptedDataMarker() -> std::string {
+  return "GF-ENCRYPTED-DATA-" + vmime::body::generateRandomBoundaryString();
+}
 
-    auto control_info_body = control_info_part->getBody();
-    auto control_info_content =
-        vmime::make_shared<vmime::stringContentHandler>("Version: 1");
-    control_info_body->setContents(control_info_content);
+// Writes the envelope around the armored data straight to the device. The
+// data is put in place of a marker while writing, it never becomes a part of
+// the object graph.
+auto WriteEncryptedEnvelope(const vmime::shared_ptr<vmime::message>& message,
+                            const QByteArray& encrypted_data,
+                            QIODevice& device, QString& error_string) -> int {
+  const auto marker = EncryptedDataMarker();
+  BuildEncryptedEnvelope(message, marker);
+
+  if (!GenerateEMLTo(*message, device, vmime::lineLengthLimits::convenient,
+                     QByteArray::fromStdString(marker), encrypted_data)) {
+    error_string = "Cannot write EML Data: " + device.errorString();
+    return kFAILED;
+  }
+  return kSUCCESS;
+}
 
-    auto encrypted_data_part_header = encrypted_data_part->getHeader();
-    auto encrypted_data_content_type_field =
-        encrypted_data_part_header->getField<vmime::contentTypeField>(
-            vmime::fields::CONTENT_TYPE);
-    encrypted_data_content_type_field->setValue("application/octet-stream");
-    encrypted_data_content_type_field->appendParameter(
-        vmime::make_shared<vmime::parameter>("name", "encrypted.asc"));
-
-    auto encrypted_data_content_desc_header_field =
-        encrypted_data_part_header->getField(
-            vmime::fields::CONTENT_DESCRIPTION);
-    encrypted_data_content_desc_header_field->setValue(
-        "OpenPGP encrypted message");
-
-    auto encrypted_data_content_disp_header_field =
-        encrypted_data_part_header->getField<vmime::contentDispositionField>(
-            vmime::fields::CONTENT_DISPOSITION);
-    encrypted_data_content_disp_header_field->setValue("inline");
-    encrypted_data_content_disp_header_field->setFilename(
-        vmime::word(std::string{"encrypted.asc"}));
+}  // namespace
 
-    auto encrypted_data_body = encrypted_data_part->getBody();
-    auto encrypted_data_content =
-        vmime::make_shared<vmime::stringContentHandler>(
-            encrypted_data.toStdString());
-    encrypted_data_body->setContents(encrypted_data_content);
+auto EncryptPlainText(int channel, const QStringList& keys,
+                      const EMailMetaData& meta_data,
+                      const QByteArray& body_data, QString& eml_data,
+                      gpgme_error_t& err, QString& capsule_id) -> int {
+  EMailArenaScope arena("encrypt plain text");
+
+  try {
+    QByteArray encrypted_data;
+    auto ret = EncryptBytes(channel, keys, body_data, encrypted_data, err,
+                            capsule_id, eml_data);
+    if (ret != kSUCCESS) return ret;
+
+    auto msg = BuildPlainTextMessage(meta_data);
+    BuildEncryptedEnvelope(msg, encrypted_data.toStdString());
 
     eml_data = Q_SC(msg->generate(vmime::lineLengthLimits::convenient));
-    FLOG_DEBUG("EML Data: %1", eml_data);
+    FLOG_DEBUG("EML Data: %1", LogPayload(eml_data));
 
     return kSUCCESS;
 
@@ -198,192 +343,208 @@ auto EncryptPlainText(int channel, const QStringList& keys,
     eml_data = QString("VMIME Error: %1").arg(e.what());
     return kEML_FAILED;
   }
-
-  eml_data = QString("Unknown Error: %1");
-  return kFAILED;
 }
 
-auto EncryptEMLData(int channel, const QStringList& keys,
-                    const vmime::shared_ptr<vmime::message>& message,
-                    const QByteArray& body_data, QString& eml_data,
-                    gpgme_error_t& err, QString& capsule_id) -> int {
-  try {
-    auto header = message->getHeader();
-    auto body = message->getBody();
-
-    auto body_offset = body->getParsedOffset();
-    auto body_len = body->getParsedLength();
-
-    auto plain_body_signed_raw_data = body_data.mid(
-        static_cast<qsizetype>(body_offset), static_cast<qsizetype>(body_len));
-
-    auto backup_content_type_header_field_component =
-        header->getField<vmime::headerField>(vmime::fields::CONTENT_TYPE)
-            ->clone();
-
-    std::shared_ptr<vmime::headerField> backup_content_type_header_field =
-        std::static_pointer_cast<vmime::headerField>(
-            backup_content_type_header_field_component);
+auto EncryptPlainTextTo(int channel, const QStringList& keys,
+                        const EMailMetaData& meta_data,
+                        const QByteArray& body_data, QIODevice& device,
+                        QString& error_string, gpgme_error_t& err,
+                        QString& capsule_id) -> int {
+  EMailArenaScope arena("encrypt plain text to device");
 
-    auto backup_from_field_component =
-        header->getField<vmime::headerField>(vmime::fields::FROM)->clone();
-
-    std::shared_ptr<vmime::headerField> backup_from_field =
-        std::static_pointer_cast<vmime::headerField>(
-            backup_from_field_component);
-
-    auto backup_to_field_component =
-        header->getField<vmime::headerField>(vmime::fields::TO)->clone();
-
-    std::shared_ptr<vmime::headerField> backup_to_field =
-        std::static_pointer_cast<vmime::headerField>(backup_to_field_component);
-
-    auto backup_message_id_field_component =
-        header->hasField(vmime::fields::MESSAGE_ID)
-            ? header->getField<vmime::headerField>(vmime::fields::MESSAGE_ID)
-                  ->clone()
-            : nullptr;
-
-    std::shared_ptr<vmime::headerField> backup_message_id_field =
-        std::static_pointer_cast<vmime::headerField>(
-            backup_message_id_field_component);
-
-    auto backup_subject_field_component =
-        header->getField<vmime::headerField>(vmime::fields::SUBJECT)->clone();
-
-    std::shared_ptr<vmime::headerField> backup_subject_field =
-        std::static_pointer_cast<vmime::headerField>(
-            backup_subject_field_component);
-
-    auto plain_part = vmime::make_shared<vmime::bodyPart>();
-    auto plain_part_header = plain_part->getHeader();
-    plain_part_header->appendField(backup_content_type_header_field);
-    plain_part_header->appendField(backup_subject_field);
-    plain_part_header->appendField(backup_from_field);
-    plain_part_header->appendField(backup_to_field);
-    if (backup_message_id_field != nullptr) {
-      plain_part_header->appendField(backup_message_id_field);
-    }
+  try {
+    QByteArray encrypted_data;
+    auto ret = EncryptBytes(channel, keys, body_data, encrypted_data, err,
+                            capsule_id, error_string);
+    if (ret != kSUCCESS) return ret;
 
-    auto plain_header_raw_data =
-        Q_SC(plain_part_header->generate(vmime::lineLengthLimits::convenient));
+    return WriteEncryptedEnvelope(BuildPlainTextMessage(meta_data),
+                                  encrypted_data, device, error_string);
+  } catch (const vmime::exception& e) {
+    error_string = QString("VMIME Error: %1").arg(e.what());
+    return kEML_FAILED;
+  }
+}
 
-    auto plain_raw_data =
-        plain_header_raw_data + "\r\n" + plain_body_signed_raw_data;
+namespace {
 
-    plain_raw_data.replace("\r\n", "\n");
-    plain_raw_data.replace("\n", "\r\n");
+auto EncryptEMLMessageBody(int channel, const QStringList& keys,
+                           const vmime::shared_ptr<vmime::message>& message,
+                           const QByteArray& plain_body_signed_raw_data,
+                           QString& eml_data, gpgme_error_t& err,
+                           QString& capsule_id) -> int {
+  EMailArenaScope arena("encrypt");
 
-    GFGpgEncryptionResult* s = nullptr;
-    auto ret = GFGpgEncryptData(channel, QStringListToCharArray(keys),
-                                keys.size(), QDUP(plain_raw_data), 1, &s);
+  try {
+    auto plain_raw_data = BuildEncryptionPlainText(message->getHeader(),
+                                                   plain_body_signed_raw_data);
 
-    auto encrypted_data = UDUP(s->encrypted_data);
-    err = s->gpgme_error;
-    capsule_id = UDUP(s->capsule_id);
-    auto gpg_error_string = UDUP(s->error_string);
+    QByteArray encrypted_data;
+    auto ret = EncryptBytes(channel, keys, plain_raw_data, encrypted_data, err,
+                            capsule_id, eml_data);
+    if (ret != kSUCCESS) return ret;
 
-    GFGpgFreeResult(s->gpgme_encrypt_result);
-    GFFreeMemory(s);
+    BuildEncryptedEnvelope(message, encrypted_data.toStdString());
 
-    if (ret != 0) {
-      eml_data = "Operation Failed";
-      return kFAILED;
-    }
+    eml_data = Q_SC(message->generate(vmime::lineLengthLimits::convenient));
+    FLOG_DEBUG("EML Data: %1", LogPayload(eml_data));
 
-    if (err != GPG_ERR_NO_ERROR) {
-      eml_data = "Encryption Failed: " + gpg_error_string;
-      return kGPG_FAILED;
-    }
+    return kSUCCESS;
 
-    // no Content-Transfer-Encoding
-    header->removeField(
-        header->getField(vmime::fields::CONTENT_TRANSFER_ENCODING));
+  } catch (const vmime::exception& e) {
+    eml_data = QString("VMIME Error: %1").arg(e.what());
+    return kEML_FAILED;
+  }
 
-    auto content_type_header_field =
-        header->getField<vmime::contentTypeField>(vmime::fields::CONTENT_TYPE);
-    content_type_header_field->setValue("multipart/encrypted");
-    content_type_header_field->appendParameter(
-        vmime::make_shared<vmime::parameter>("protocol",
-                                             "application/pgp-encrypted"));
+  eml_data = QString("Unknown Error: %1");
+  return kFAILED;
+}
 
-    // hide subject
-    header->Subject()->setValue("...");
+}  // namespace
 
-    auto root_part_boundary = vmime::body::generateRandomBoundaryString();
-    content_type_header_field->setBoundary(root_part_boundary);
+auto EncryptEMLData(int channel, const QStringList& keys,
+                    const vmime::shared_ptr<vmime::message>& message,
+                    const QByteArray& body_data, QString& eml_data,
+                    gpgme_error_t& err, QString& capsule_id) -> int {
+  auto body = message->getBody();
+  auto plain_body_signed_raw_data = ByteArrayView(
+      body_data, body->getParsedOffset(), body->getParsedLength());
 
-    auto root_body_part = vmime::make_shared<vmime::bodyPart>();
-    auto control_info_part = vmime::make_shared<vmime::bodyPart>();
-    auto encrypted_data_part = vmime::make_shared<vmime::bodyPart>();
+  return EncryptEMLMessageBody(channel, keys, message,
+                               plain_body_signed_raw_data, eml_data, err,
+                               capsule_id);
+}
 
-    root_body_part->getBody()->appendPart(control_info_part);
-    root_body_part->getBody()->appendPart(encrypted_data_part);
-    root_body_part->getBody()->setPrologText(
-        "This is an OpenPGP/MIME encrypted message (RFC 4880 and 3156)");
-    message->setBody(root_body_part->getBody());
+auto EncryptEMLMessage(int channel, const QStringList& keys,
+                       const vmime::shared_ptr<vmime::message>& message,
+                       QString& eml_data, gpgme_error_t& err,
+                       QString& capsule_id) -> int {
+  QByteArray plain_body_raw_data;
+  try {
+    plain_body_raw_data = GenerateEMLBytes(
+        *message->getBody(), vmime::lineLengthLimits::convenient);
+  } catch (const vmime::exception& e) {
+    eml_data = QString("VMIME Error: %1").arg(e.what());
+    return kEML_FAILED;
+  }
 
-    auto control_info_part_header = control_info_part->getHeader();
-    auto control_info_content_type_field =
-        control_info_part_header->getField<vmime::contentTypeField>(
-            vmime::fields::CONTENT_TYPE);
-    control_info_content_type_field->setValue("application/pgp-encrypted");
+  return EncryptEMLMessageBody(channel, keys, message, plain_body_raw_data,
+                               eml_data, err, capsule_id);
+}
 
-    auto control_info_part_content_desc_header_field =
-        control_info_part_header->getField(vmime::fields::CONTENT_DESCRIPTION);
-    control_info_part_content_desc_header_field->setValue(
-        "PGP/MIME version identification");
+auto EncryptEMLDataTo(int channel, const QStringList& keys,
+                      const vmime::shared_ptr<vmime::message>& message,
+                      const QByteArray& body_data, QIODevice& device,
+                      QString& error_string, gpgme_error_t& err,
+                      QString& capsule_id) -> int {
+  EMailArenaScope arena("encrypt to device");
 
-    auto control_info_body = control_info_part->getBody();
-    auto control_info_content =
-        vmime::make_shared<vmime::stringContentHandler>("Version: 1");
-    control_info_body->setContents(control_info_content);
+  try {
+    auto body = message->getBody();
+    auto plain_raw_data = BuildEncryptionPlainText(
+        message->getHeader(),
+        ByteArrayView(body_data, body->getParsedOffset(),
+                      body->getParsedLength()));
+
+    QByteArray encrypted_data;
+    auto ret = EncryptBytes(channel, keys, plain_raw_data, encrypted_data, err,
+                            capsule_id, error_string);
+    if (ret != kSUCCESS) return ret;
+
+    // the plaintext copy is not needed while the envelope is written
+    plain_raw_data = QByteArray{};
+    return WriteEncryptedEnvelope(message, encrypted_data, device,
+                                  error_string);
+  } catch (const vmime::exception& e) {
+    error_string = QString("VMIME Error: %1").arg(e.what());
+    return kEML_FAILED;
+  }
+}
 
-    auto encrypted_data_part_header = encrypted_data_part->getHeader();
-    auto encrypted_data_content_type_field =
-        encrypted_data_part_header->getField<vmime::contentTypeField>(
-            vmime::fields::CONTENT_TYPE);
-    encrypted_data_content_type_field->setValue("application/octet-stream");
-    encrypted_data_content_type_field->appendParameter(
-        vmime::make_shared<vmime::parameter>("name", "encrypted.asc"));
-
-    auto encrypted_data_content_desc_header_field =
-        encrypted_data_part_header->getField(
-            vmime::fields::CONTENT_DESCRIPTION);
-    encrypted_data_content_desc_header_field->setValue(
-        "OpenPGP encrypted message");
-
-    auto encrypted_data_content_disp_header_field =
-        encrypted_data_part_header->getField<vmime::contentDispositionField>(
-            vmime::fields::CONTENT_DISPOSITION);
-    encrypted_data_content_disp_header_field->setValue("inline");
-    encrypted_data_content_disp_header_field->setFilename(
-        vmime::word(std::string{"encrypted.asc"}));
+namespace {
+
+void EncryptForRecipient(int channel, const QByteArray& plain_raw_data,
+                         const QByteArray& envelope_head,
+                         const QByteArray& envelope_tail,
+                         EMailRecipientEML& result) {
+  QByteArray encrypted_data;
+  result.ret = EncryptBytes(channel, {result.key}, plain_raw_data,
+                            encrypted_data, result.err, result.capsule_id,
+                            result.eml_data);
+  if (result.ret != kSUCCESS) return;
+
+  QByteArray eml;
+  eml.reserve(envelope_head.size() + encrypted_data.size() +
+              envelope_tail.size());
+  eml += envelope_head;
+  eml += encrypted_data;
+  eml += envelope_tail;
+  result.eml_data = QString::fromUtf8(eml);
+}
 
-    auto encrypted_data_body = encrypted_data_part->getBody();
-    auto encrypted_data_content =
-        vmime::make_shared<vmime::stringContentHandler>(
-            encrypted_data.toStdString());
-    encrypted_data_body->setContents(encrypted_data_content);
+}  // namespace
 
-    eml_data = Q_SC(message->generate(vmime::lineLengthLimits::convenient));
-    FLOG_DEBUG("EML Data: %1", eml_data);
+auto EncryptEMLDataPerRecipient(
+    int channel, const QStringList& keys,
+    const vmime::shared_ptr<vmime::message>& message,
+    const QByteArray& body_data, QList<EMailRecipientEML>& results,
+    QString& error_string) -> int {
+  EMailArenaScope arena("encrypt fan-out");
 
-    return kSUCCESS;
+  QByteArray plain_raw_data;
+  QByteArray envelope_head;
+  QByteArray envelope_tail;
+  try {
+    auto body = message->getBody();
+    plain_raw_data = BuildEncryptionPlainText(
+        message->getHeader(),
+        ByteArrayView(body_data, body->getParsedOffset(),
+                      body->getParsedLength()));
+
+    // the envelope is generated once around a marker line, every ciphertext
+    // is spliced in at its place
+    const auto marker = EncryptedDataMarker();
+    NeutralizeRecipientHeaders(message->getHeader());
+    BuildEncryptedEnvelope(message, marker);
+
+    auto envelope =
+        GenerateEMLBytes(*message, vmime::lineLengthLimits::convenient);
+    const auto pos = envelope.indexOf(marker.c_str());
+    if (pos < 0) {
+      error_string = "Cannot locate the encrypted part in the envelope";
+      return kEML_FAILED;
+    }
 
+    envelope_head = envelope.left(pos);
+    envelope_tail = envelope.mid(pos + static_cast<qsizetype>(marker.size()));
   } catch (const vmime::exception& e) {
-    eml_data = QString("VMIME Error: %1").arg(e.what());
+    error_string = QString("VMIME Error: %1").arg(e.what());
     return kEML_FAILED;
   }
 
-  eml_data = QString("Unknown Error: %1");
-  return kFAILED;
+  // one after another: every encryption holds the channel lock, so more
+  // workers would only wait on it
+  results.clear();
+  results.reserve(keys.size());
+  for (const auto& key : keys) {
+    EMailRecipientEML result;
+    result.key = key;
+    EncryptForRecipient(channel, plain_raw_data, envelope_head, envelope_tail,
+                        result);
+    results.append(result);
+  }
+
+  return kSUCCESS;
 }
 
-auto SignPlainText(int channel, const QString& key,
-                   const EMailMetaData& meta_data, const QByteArray& body_data,
-                   QString& eml_data, gpgme_error_t& err, QString& capsule_id)
-    -> int {
+auto SignPlainTextMessage(int channel, const QString& key,
+                          const EMailMetaData& meta_data,
+                          const QByteArray& body_data,
+                          vmime::shared_ptr<vmime::message>& message,
+                          QString& error_string, gpgme_error_t& err,
+                          QString& capsule_id) -> int {
+  EMailArenaScope arena("sign plain text");
+
   auto from = meta_data.from;
   auto recipient_list = meta_data.to;
   auto cc_list = meta_data.cc;
@@ -408,12 +569,11 @@ auto SignPlainText(int channel, const QString& key,
 
       if (ParseEmailString(trimmed_recipient, name, email)) {
         msg_builder.getRecipients().appendAddress(
-            vmime::make_shared<vmime::mailbox>(vmime::text(name.toStdString()),
-                                               email.toStdString()));
+            EMailMakeShared<vmime::mailbox>(vmime::text(name.toStdString()),
+                                            email.toStdString()));
       } else {
         msg_builder.getRecipients().appendAddress(
-            vmime::make_shared<vmime::mailbox>(
-                trimmed_recipient.toStdString()));
+            EMailMakeShared<vmime::mailbox>(trimmed_recipient.toStdString()));
       }
     }
 
@@ -421,12 +581,11 @@ auto SignPlainText(int channel, const QString& key,
       auto trimmed_recipient = recipient.trimmed();
       if (ParseEmailString(trimmed_recipient, name, email)) {
         msg_builder.getCopyRecipients().appendAddress(
-            vmime::make_shared<vmime::mailbox>(vmime::text(name.toStdString()),
-                                               email.toStdString()));
+            EMailMakeShared<vmime::mailbox>(vmime::text(name.toStdString()),
+                                            email.toStdString()));
       } else {
         msg_builder.getCopyRecipients().appendAddress(
-            vmime::make_shared<vmime::mailbox>(
-                trimmed_recipient.toStdString()));
+            EMailMakeShared<vmime::mailbox>(trimmed_recipient.toStdString()));
       }
     }
 
@@ -434,12 +593,11 @@ auto SignPlainText(int channel, const QString& key,
       auto trimmed_recipient = recipient.trimmed();
       if (ParseEmailString(trimmed_recipient, name, email)) {
         msg_builder.getBlindCopyRecipients().appendAddress(
-            vmime::make_shared<vmime::mailbox>(vmime::text(name.toStdString()),
-                                               email.toStdString()));
+            EMailMakeShared<vmime::mailbox>(vmime::text(name.toStdString()),
+                                            email.toStdString()));
       } else {
         msg_builder.getBlindCopyRecipients().appendAddress(
-            vmime::make_shared<vmime::mailbox>(
-                trimmed_recipient.toStdString()));
+            EMailMakeShared<vmime::mailbox>(trimmed_recipient.toStdString()));
       }
     }
 
@@ -460,15 +618,15 @@ auto SignPlainText(int channel, const QString& key,
     content_type_header_field->setValue("multipart/signed");
     auto body_boundary = vmime::body::generateRandomBoundaryString();
     content_type_header_field->appendParameter(
-        vmime::make_shared<vmime::parameter>("protocol",
-                                             "application/pgp-signature"));
+        EMailMakeShared<vmime::parameter>("protocol",
+                                          "application/pgp-signature"));
     content_type_header_field->setBoundary(body_boundary);
 
-    auto root_body_part = vmime::make_shared<vmime::bodyPart>();
-    auto container_part = vmime::make_shared<vmime::bodyPart>();
-    auto mime_part = vmime::make_shared<vmime::bodyPart>();
-    auto public_key_part = vmime::make_shared<vmime::bodyPart>();
-    auto signature_part = vmime::make_shared<vmime::bodyPart>();
+    auto root_body_part = EMailMakeShared<vmime::bodyPart>();
+    auto container_part = EMailMakeShared<vmime::bodyPart>();
+    auto mime_part = EMailMakeShared<vmime::bodyPart>();
+    auto public_key_part = EMailMakeShared<vmime::bodyPart>();
+    auto signature_part = EMailMakeShared<vmime::bodyPart>();
 
     root_body_part->getBody()->appendPart(container_part);
     root_body_part->getBody()->appendPart(signature_part);
@@ -498,8 +656,8 @@ auto SignPlainText(int channel, const QString& key,
             vmime::fields::CONTENT_TYPE);
     public_key_part_content_type_header_field->setValue("application/pgp-keys");
     public_key_part_content_type_header_field->appendParameter(
-        vmime::make_shared<vmime::parameter>("name",
-                                             public_key_name.toStdString()));
+        EMailMakeShared<vmime::parameter>("name",
+                                          public_key_name.toStdString()));
 
     auto public_key_part_content_desc_header_field =
         public_key_part_header->getField(vmime::fields::CONTENT_DESCRIPTION);
@@ -525,7 +683,7 @@ auto SignPlainText(int channel, const QString& key,
     signature_part_content_type_header_field->setValue(
         "application/pgp-signature");
     signature_part_content_type_header_field->appendParameter(
-        vmime::make_shared<vmime::parameter>("name", "OpenPGP_signature.asc"));
+        EMailMakeShared<vmime::parameter>("name", "OpenPGP_signature.asc"));
 
     auto signature_part_content_desc_header_field =
         signature_part_header->getField(vmime::fields::CONTENT_DESCRIPTION);
@@ -539,22 +697,15 @@ auto SignPlainText(int channel, const QString& key,
     signature_part_content_disp_header_field->setFilename(
         vmime::word(std::string{"OpenPGP_signature.asc"}));
 
-    auto public_key = UDUP(GFGpgPublicKey(channel, QDUP(key), 1));
-    if (public_key.isEmpty()) {
-      eml_data = "Get Public Key of Sign Key Failed";
+    // exported and encoded once per key and channel
+    auto public_key_content =
+        EMailKeyringCache::GetInstance().PublicKeyContent(channel, key);
+    if (!public_key_content) {
+      error_string = "Get Public Key of Sign Key Failed";
       return kFAILED;
     }
 
-    public_key.replace("\r\n", "\n");
-    public_key.replace("\n", "\r\n");
-
-    auto public_key_part_part_body = public_key_part->getBody();
-    auto public_key_part_body_content =
-        vmime::make_shared<vmime::stringContentHandler>();
-    public_key_part_body_content->setData(
-        public_key.toLatin1().toStdString(),
-        vmime::encoding(vmime::encodingTypes::QUOTED_PRINTABLE));
-    public_key_part_part_body->setContents(public_key_part_body_content);
+    public_key_part->getBody()->setContents(public_key_content);
 
     auto mime_part_header = mime_part->getHeader();
 
@@ -563,35 +714,38 @@ auto SignPlainText(int channel, const QString& key,
             vmime::fields::CONTENT_TYPE);
     mime_part_content_type_header_field->setValue("text/plain");
     mime_part_content_type_header_field->appendParameter(
-        vmime::make_shared<vmime::parameter>("charset", "UTF-8"));
+        EMailMakeShared<vmime::parameter>("charset", "UTF-8"));
     mime_part_content_type_header_field->appendParameter(
-        vmime::make_shared<vmime::parameter>("format", "flowed"));
+        EMailMakeShared<vmime::parameter>("format", "flowed"));
     auto mime_part_content_trans_encode_field =
         mime_part_header->getField(vmime::fields::CONTENT_TRANSFER_ENCODING);
     mime_part_content_trans_encode_field->setValue("base64");
 
     auto mime_part_part_body = mime_part->getBody();
     auto mime_part_body_content =
-        vmime::make_shared<vmime::stringContentHandler>();
+        EMailMakeShared<vmime::stringContentHandler>();
     mime_part_body_content->setData(body_data.toStdString());
     mime_part_part_body->setContents(mime_part_body_content);
 
-    auto container_raw_data =
-        Q_SC(container_part->generate(vmime::lineLengthLimits::convenient));
+    auto container_raw_data = GenerateEMLBytes(
+        *container_part, vmime::lineLengthLimits::convenient);
 
     auto container_raw_data_hash = QCryptographicHash::hash(
-        container_raw_data.toLatin1(), QCryptographicHash::Sha1);
+        container_raw_data, QCryptographicHash::Sha1);
     FLOG_DEBUG("raw content of signature hash: %1",
                container_raw_data_hash.toHex());
 
-    FLOG_DEBUG("MIME Raw Data For Signature: %1", container_raw_data);
+    FLOG_DEBUG("MIME Raw Data For Signature: %1",
+               LogPayload(container_raw_data));
     FLOG_DEBUG("Signature Channel: %1, Sign Key: %2", channel, key);
 
     GFGpgSignResult* s;
-    auto ret = GFGpgSignData(channel, QStringListToCharArray({key}), 1,
-                             QDUP(container_raw_data), 1, 1, &s);
+    auto ret = WithGpgChannel(channel, [&]() {
+      return GFGpgSignData(channel, QStringListToCharArray({key}), 1,
+                           BDUP(container_raw_data), 1, 1, &s);
+    });
 
-    auto signature = UDUP(s->signature);
+    auto signature = UBDUP(s->signature);
     auto hash_algo = UDUP(s->hash_algo);
     err = s->gpgme_error;
     capsule_id = UDUP(s->capsule_id);
@@ -601,46 +755,57 @@ auto SignPlainText(int channel, const QString& key,
     GFFreeMemory(s);
 
     if (ret != kSUCCESS) {
-      eml_data = "Operation Failed";
+      error_string = "Operation Failed";
       return kFAILED;
     }
 
     if (err != GPG_ERR_NO_ERROR) {
-      eml_data = "Sign Failed: " + gpg_error_string;
+      error_string = "Sign Failed: " + gpg_error_string;
       return kGPG_FAILED;
     }
 
-    FLOG_DEBUG("Hash Algo: %1 Signature Data: %2", hash_algo, signature);
+    FLOG_DEBUG("Hash Algo: %1 Signature Data: %2", hash_algo,
+               LogPayload(signature));
     content_type_header_field->appendParameter(
-        vmime::make_shared<vmime::parameter>(
+        EMailMakeShared<vmime::parameter>(
             "micalg",
             QString("pgp-%1").arg(hash_algo.toLower()).toStdString()));
 
     auto signature_part_body = signature_part->getBody();
     auto signature_part_body_content =
-        vmime::make_shared<vmime::stringContentHandler>(
-            signature.toStdString());
+        EMailMakeShared<vmime::stringContentHandler>(signature.toStdString());
     signature_part_body->setContents(signature_part_body_content);
 
-    eml_data = Q_SC(msg->generate(vmime::lineLengthLimits::convenient));
-
-    FLOG_DEBUG("EML Data: %1", eml_data);
-
+    message = msg;
     return kSUCCESS;
 
   } catch (const vmime::exception& e) {
-    eml_data = QString("VMIME Error: %1").arg(e.what());
+    error_string = QString("VMIME Error: %1").arg(e.what());
     return kEML_FAILED;
   }
 
-  eml_data = QString("Unknown Error: %1");
+  error_string = QString("Unknown Error: %1");
   return kFAILED;
 }
 
-auto SignEMLData(int channel, const QString& key,
-                 const vmime::shared_ptr<vmime::message>& message,
-                 QString& eml_data, gpgme_error_t& err, QString& capsule_id)
+auto SignPlainText(int channel, const QString& key,
+                   const EMailMetaData& meta_data, const QByteArray& body_data,
+                   QString& eml_data, gpgme_error_t& err, QString& capsule_id)
     -> int {
+  vmime::shared_ptr<vmime::message> message;
+  auto ret = SignPlainTextMessage(channel, key, meta_data, body_data, message,
+                                  eml_data, err, capsule_id);
+  if (ret != kSUCCESS) return ret;
+
+  return GenerateEMLData(message, eml_data);
+}
+
+auto SignEMLMessage(int channel, const QString& key,
+                    const vmime::shared_ptr<vmime::message>& message,
+                    QString& error_string, gpgme_error_t& err,
+                    QString& capsule_id) -> int {
+  EMailArenaScope arena("sign");
+
   try {
     auto header = message->getHeader();
 
@@ -685,19 +850,19 @@ auto SignEMLData(int channel, const QString& key,
     content_type_header_field->setValue("multipart/signed");
     auto body_boundary = vmime::body::generateRandomBoundaryString();
     content_type_header_field->appendParameter(
-        vmime::make_shared<vmime::parameter>("protocol",
-                                             "application/pgp-signature"));
+        EMailMakeShared<vmime::parameter>("protocol",
+                                          "application/pgp-signature"));
     content_type_header_field->setBoundary(body_boundary);
 
     // update date field
     auto datetime_header_field = header->Date();
     datetime_header_field->setValue(vmime::datetime::now());
 
-    auto root_body_part = vmime::make_shared<vmime::bodyPart>();
-    auto container_part = vmime::make_shared<vmime::bodyPart>();
-    auto mime_part = vmime::make_shared<vmime::bodyPart>();
-    auto public_key_part = vmime::make_shared<vmime::bodyPart>();
-    auto signature_part = vmime::make_shared<vmime::bodyPart>();
+    auto root_body_part = EMailMakeShared<vmime::bodyPart>();
+    auto container_part = EMailMakeShared<vmime::bodyPart>();
+    auto mime_part = EMailMakeShared<vmime::bodyPart>();
+    auto public_key_part = EMailMakeShared<vmime::bodyPart>();
+    auto signature_part = EMailMakeShared<vmime::bodyPart>();
 
     root_body_part->getBody()->appendPart(container_part);
     root_body_part->getBody()->appendPart(signature_part);
@@ -726,8 +891,8 @@ auto SignEMLData(int channel, const QString& key,
             vmime::fields::CONTENT_TYPE);
     public_key_part_content_type_header_field->setValue("application/pgp-keys");
     public_key_part_content_type_header_field->appendParameter(
-        vmime::make_shared<vmime::parameter>("name",
-                                             public_key_name.toStdString()));
+        EMailMakeShared<vmime::parameter>("name",
+                                          public_key_name.toStdString()));
 
     auto public_key_part_content_desc_header_field =
         public_key_part_header->getField(vmime::fields::CONTENT_DESCRIPTION);
@@ -753,7 +918,7 @@ auto SignEMLData(int channel, const QString& key,
     signature_part_content_type_header_field->setValue(
         "application/pgp-signature");
     signature_part_content_type_header_field->appendParameter(
-        vmime::make_shared<vmime::parameter>("name", "OpenPGP_signature.asc"));
+        EMailMakeShared<vmime::parameter>("name", "OpenPGP_signature.asc"));
 
     auto signature_part_content_desc_header_field =
         signature_part_header->getField(vmime::fields::CONTENT_DESCRIPTION);
@@ -767,22 +932,15 @@ auto SignEMLData(int channel, const QString& key,
     signature_part_content_disp_header_field->setFilename(
         vmime::word(std::string{"OpenPGP_signature.asc"}));
 
-    auto public_key = UDUP(GFGpgPublicKey(channel, QDUP(key), 1));
-    if (public_key.isEmpty()) {
-      eml_data = "Get Public Key of Sign Key Failed";
+    // exported and encoded once per key and channel
+    auto public_key_content =
+        EMailKeyringCache::GetInstance().PublicKeyContent(channel, key);
+    if (!public_key_content) {
+      error_string = "Get Public Key of Sign Key Failed";
       return kFAILED;
     }
 
-    public_key.replace("\r\n", "\n");
-    public_key.replace("\n", "\r\n");
-
-    auto public_key_part_part_body = public_key_part->getBody();
-    auto public_key_part_body_content =
-        vmime::make_shared<vmime::stringContentHandler>();
-    public_key_part_body_content->setData(
-        public_key.toLatin1().toStdString(),
-        vmime::encoding(vmime::encodingTypes::QUOTED_PRINTABLE));
-    public_key_part_part_body->setContents(public_key_part_body_content);
+    public_key_part->getBody()->setContents(public_key_content);
 
     auto mime_part_header = mime_part->getHeader();
 
@@ -800,25 +958,28 @@ auto SignEMLData(int channel, const QString& key,
 
     mime_part->setBody(backup_body);
 
-    auto container_raw_data =
-        Q_SC(container_part->generate(vmime::lineLengthLimits::convenient));
+    auto container_raw_data = GenerateEMLBytes(
+        *container_part, vmime::lineLengthLimits::convenient);
 
     container_raw_data.replace("\r\n", "\n");
     container_raw_data.replace("\n", "\r\n");
 
     auto container_raw_data_hash = QCryptographicHash::hash(
-        container_raw_data.toLatin1(), QCryptographicHash::Sha1);
+        container_raw_data, QCryptographicHash::Sha1);
     FLOG_DEBUG("raw content of signature hash: %1",
                container_raw_data_hash.toHex());
 
-    FLOG_DEBUG("MIME Raw Data For Signature: %1", container_raw_data);
+    FLOG_DEBUG("MIME Raw Data For Signature: %1",
+               LogPayload(container_raw_data));
     FLOG_DEBUG("Signature Channel: %1, Sign Key: %2", channel, key);
 
     GFGpgSignResult* s;
-    auto ret = GFGpgSignData(channel, QStringListToCharArray({key}), 1,
-                             QDUP(container_raw_data), 1, 1, &s);
+    auto ret = WithGpgChannel(channel, [&]() {
+      return GFGpgSignData(channel, QStringListToCharArray({key}), 1,
+                           BDUP(container_raw_data), 1, 1, &s);
+    });
 
-    auto signature = UDUP(s->signature);
+    auto signature = UBDUP(s->signature);
     auto hash_algo = UDUP(s->hash_algo);
     auto gpg_error_string = UDUP(s->error_string);
     err = s->gpgme_error;
@@ -828,55 +989,64 @@ auto SignEMLData(int channel, const QString& key,
     GFFreeMemory(s);
 
     if (ret != 0) {
-      eml_data = "Operation Failed.";
+      error_string = "Operation Failed.";
       return kFAILED;
     }
 
     if (err != GPG_ERR_NO_ERROR) {
-      eml_data = "Sign Failed: " + gpg_error_string;
+      error_string = "Sign Failed: " + gpg_error_string;
       return kGPG_FAILED;
     }
 
-    FLOG_DEBUG("Hash Algo: %1 Signature Data: %2", hash_algo, signature);
+    FLOG_DEBUG("Hash Algo: %1 Signature Data: %2", hash_algo,
+               LogPayload(signature));
     content_type_header_field->appendParameter(
-        vmime::make_shared<vmime::parameter>(
+        EMailMakeShared<vmime::parameter>(
             "micalg",
             QString("pgp-%1").arg(hash_algo.toLower()).toStdString()));
 
     auto signature_part_body = signature_part->getBody();
     auto signature_part_body_content =
-        vmime::make_shared<vmime::stringContentHandler>(
-            signature.toStdString());
+        EMailMakeShared<vmime::stringContentHandler>(signature.toStdString());
     signature_part_body->setContents(signature_part_body_content);
 
-    eml_data = Q_SC(message->generate(vmime::lineLengthLimits::convenient));
-
-    FLOG_DEBUG("EML Data: %1", eml_data);
-
     return kSUCCESS;
 
   } catch (const vmime::exception& e) {
-    eml_data = QString("VMIME Error: %1").arg(e.what());
+    error_string = QString("VMIME Error: %1").arg(e.what());
     return kEML_FAILED;
   }
 
-  eml_data = QString("Unknown Error: %1");
+  error_string = QString("Unknown Error: %1");
   return kFAILED;
 }
 
-auto VerifyEMLData(int channel, const QByteArray& data,
-                   EMailMetaData& meta_data, QString& error_string,
-                   gpgme_error_t& err, QString& capsule_id) -> int {
-  vmime::string vmime_data(data.constData(), data.size());
+auto SignEMLData(int channel, const QString& key,
+                 const vmime::shared_ptr<vmime::message>& message,
+                 QString& eml_data, gpgme_error_t& err, QString& capsule_id)
+    -> int {
+  auto ret = SignEMLMessage(channel, key, message, eml_data, err, capsule_id);
+  if (ret != kSUCCESS) return ret;
 
-  auto message = vmime::make_shared<vmime::message>();
-  try {
-    message->parse(vmime_data);
-  } catch (const vmime::exception& e) {
-    FLOG_DEBUG("error when parsing vmime data: %1", e.what());
-    error_string = "Error when parsing eml raw data";
-    return kEML_FAILED;
-  }
+  return GenerateEMLData(message, eml_data);
+}
+
+auto IsSignedEMLMessage(const EMailParsedMessage& parsed) -> bool {
+  QMutexLocker locker(&parsed.lock);
+  auto field = parsed.message->getHeader()->findField<vmime::contentTypeField>(
+      vmime::fields::CONTENT_TYPE);
+  if (!field) return false;
+  return Q_SC(field->getValue()->generate()).trimmed() == "multipart/signed";
+}
+
+auto VerifyEMLMessage(int channel, const EMailParsedMessage& parsed,
+                      EMailMetaData& meta_data, QString& error_string,
+                      gpgme_error_t& err, QString& capsule_id) -> int {
+  QMutexLocker locker(&parsed.lock);
+
+  // parsed in place: every region below is an offset/length view into data
+  const auto& data = parsed.data;
+  const auto& message = parsed.message;
 
   auto header = message->getHeader();
 
@@ -940,23 +1110,6 @@ auto VerifyEMLData(int channel, const QByteArray& data,
     return kEML_FAILED;
   }
 
-  auto from_field_value_text =
-      ExtractFieldValueMailBox(header, vmime::fields::FROM);
-  auto to_field_value_text =
-      ExtractFieldValueAddressList(header, vmime::fields::TO);
-  auto cc_field_value_text =
-      ExtractFieldValueAddressList(header, vmime::fields::CC);
-  auto bcc_field_value_text =
-      ExtractFieldValueAddressList(header, vmime::fields::BCC);
-  auto date_field_value =
-      ExtractFieldValueDateTime(header, vmime::fields::DATE);
-  auto subject_field_value_text =
-      ExtractFieldValueText(header, vmime::fields::SUBJECT);
-  auto reply_to_field_value_text =
-      ExtractFieldValueMailBox(header, vmime::fields::REPLY_TO);
-  auto organization_text =
-      ExtractFieldValueText(header, vmime::fields::ORGANIZATION);
-
   auto body = message->getBody();
   auto content_type = body->getContentType();
   auto part_count = body->getPartCount();
@@ -980,8 +1133,8 @@ auto VerifyEMLData(int channel, const QByteArray& data,
   auto part_mime_parse_offset = part_mime->getParsedOffset();
   auto part_mime_parse_length = part_mime->getParsedLength();
 
-  auto part_mime_content_text = QByteArray::fromStdString(
-      vmime_data.substr(part_mime_parse_offset, part_mime_parse_length));
+  auto part_mime_content_text =
+      ByteArrayView(data, part_mime_parse_offset, part_mime_parse_length);
 
   FLOG_DEBUG("mime part info, raw offset: %1, length: %2",
              part_mime_parse_offset, part_mime_parse_length);
@@ -991,35 +1144,18 @@ auto VerifyEMLData(int channel, const QByteArray& data,
   FLOG_DEBUG("mime part of raw content hash: %1",
              part_mime_content_hash.toHex());
 
-  FLOG_DEBUG("mime part of raw content: %1", part_mime_content_text);
-  qDebug().noquote() << "\n" << part_mime_content_text;
+  FLOG_DEBUG("mime part of raw content: %1",
+             LogPayload(part_mime_content_text));
 
   if (part_mime_content_text.isEmpty()) {
     error_string = "Mime raw data part is empty";
     return kEML_FAILED;
   }
 
-  auto attachments =
-      vmime::attachmentHelper::findAttachmentsInBodyPart(part_mime);
-  FLOG_DEBUG("mime part info, attachment count: %1", attachments.size());
-
-  QStringList public_keys_buffer;
-
-  for (const auto& att : attachments) {
-    auto att_type = Q_SC(att->getType().generate()).trimmed();
-    FLOG_DEBUG("mime part info, attachment type: %1", att_type);
-
-    if (att_type != "application/pgp-keys") continue;
-
-    std::ostringstream oss;
-    vmime::utility::outputStreamAdapter osa(oss);
-    att->getData()->extract(osa);
-
-    public_keys_buffer.append(Q_SC(oss.str()));
-  }
-
-  FLOG_DEBUG("mime part info, attached public keys: %1",
-             public_keys_buffer.join("\n"));
+  QByteArray public_keys;
+  auto public_keys_count = ExtractPublicKeyAttachments(part_mime, public_keys);
+  FLOG_DEBUG("mime part info, attached public keys: %1, size: %2",
+             public_keys_count, public_keys.size());
 
   /*
    * The second body MUST contain the OpenPGP digital signature. It MUST
@@ -1038,23 +1174,38 @@ auto VerifyEMLData(int channel, const QByteArray& data,
     return kEML_FAILED;
   }
 
+  auto part_sign_body = part_sign->getBody();
   auto part_sign_body_content =
-      QByteArray::fromStdString(part_sign->getBody()->generate());
+      ByteArrayView(data, part_sign_body->getParsedOffset(),
+                    part_sign_body->getParsedLength());
   if (part_sign_body_content.trimmed().isEmpty()) {
     error_string = "The signature part is empty";
     return kEML_FAILED;
   }
 
-  FLOG_DEBUG("body part of signature content: %1", part_sign_body_content);
+  FLOG_DEBUG("body part of signature content: %1",
+             LogPayload(part_sign_body_content));
 
   GFGpgVerifyResult* s;
-  auto ret = GFGpgVerifyData(channel, QDUP(part_mime_content_text),
-                             QDUP(part_sign_body_content), &s);
+  auto ret = WithGpgChannel(channel, [&]() {
+    return GFGpgVerifyData(channel, BDUP(part_mime_content_text),
+                           BDUP(part_sign_body_content), &s);
+  });
 
   err = s->gpgme_error;
   capsule_id = UDUP(s->capsule_id);
   auto gpg_error_string = UDUP(s->error_string);
 
+  // taken from the result itself, the analysed cards may name other keys
+  QString signer_fpr;
+  auto* verify_result =
+      static_cast<gpgme_verify_result_t>(s->gpgme_verify_result);
+  if (verify_result != nullptr && verify_result->signatures != nullptr &&
+      verify_result->signatures->next == nullptr &&
+      verify_result->signatures->fpr != nullptr) {
+    signer_fpr = QString::fromLatin1(verify_result->signatures->fpr);
+  }
+
   GFGpgFreeResult(s->gpgme_verify_result);
   GFFreeMemory(s);
 
@@ -1068,33 +1219,44 @@ auto VerifyEMLData(int channel, const QByteArray& data,
     return kGPG_FAILED;
   }
 
-  meta_data.from = from_field_value_text;
-  meta_data.to = to_field_value_text.split(',');
-  meta_data.cc = cc_field_value_text.split(',');
-  meta_data.bcc = bcc_field_value_text.split(',');
-  meta_data.subject = subject_field_value_text;
-  meta_data.datetime = date_field_value;
+  meta_data = parsed.meta_data;
   meta_data.micalg = prm_micalg_value;
-  meta_data.public_keys = public_keys_buffer.join("\n");
+  meta_data.public_keys = public_keys;
   meta_data.mime = {};
   meta_data.mime_hash = part_mime_content_hash.toHex();
+  meta_data.signer_fpr = signer_fpr;
   meta_data.signature = {};
   return 0;
 }
 
-auto DecryptEMLData(int channel, const QByteArray& data,
-                    EMailMetaData& meta_data, QString& eml_data,
-                    gpgme_error_t& err, QString& capsule_id) -> int {
-  vmime::string vmime_data(data.constData(), data.size());
-  auto message = vmime::make_shared<vmime::message>();
+auto VerifyEMLData(int channel, const QByteArray& data,
+                   EMailMetaData& meta_data, QString& error_string,
+                   gpgme_error_t& err, QString& capsule_id) -> int {
+  EMailPGPMIMEStructure structure;
+  if (!ScanPGPMIMEStructure(data, EMailPGPMIMEType::kSigned, structure,
+                            error_string)) {
+    return kEML_FAILED;
+  }
+
+  EMailParsedMessagePtr parsed;
   try {
-    message->parse(vmime_data);
+    parsed = ParseEMailMessage(data);
   } catch (const vmime::exception& e) {
     FLOG_DEBUG("error when parsing vmime data: %1", e.what());
-    eml_data = "Error when parsing EML Data";
+    error_string = "Error when parsing eml raw data";
     return kEML_FAILED;
   }
 
+  return VerifyEMLMessage(channel, *parsed, meta_data, error_string, err,
+                          capsule_id);
+}
+
+auto DecryptEMLMessage(int channel, const EMailParsedMessage& parsed,
+                       EMailMetaData& meta_data, QString& eml_data,
+                       gpgme_error_t& err, QString& capsule_id) -> int {
+  QMutexLocker locker(&parsed.lock);
+
+  const auto& message = parsed.message;
   auto header = message->getHeader();
 
   auto content_type_field =
@@ -1135,23 +1297,6 @@ auto DecryptEMLData(int channel, const QByteArray& data,
     return kEML_FAILED;
   }
 
-  auto from_field_value_text =
-      ExtractFieldValueMailBox(header, vmime::fields::FROM);
-  auto to_field_value_text =
-      ExtractFieldValueAddressList(header, vmime::fields::TO);
-  auto cc_field_value_text =
-      ExtractFieldValueAddressList(header, vmime::fields::CC);
-  auto bcc_field_value_text =
-      ExtractFieldValueAddressList(header, vmime::fields::BCC);
-  auto date_field_value =
-      ExtractFieldValueDateTime(header, vmime::fields::DATE);
-  auto subject_field_value_text =
-      ExtractFieldValueText(header, vmime::fields::SUBJECT);
-  auto reply_to_field_value_text =
-      ExtractFieldValueMailBox(header, vmime::fields::REPLY_TO);
-  auto organization_text =
-      ExtractFieldValueText(header, vmime::fields::ORGANIZATION);
-
   auto body = message->getBody();
   auto content_type = body->getContentType();
   auto part_count = body->getPartCount();
@@ -1173,9 +1318,6 @@ auto DecryptEMLData(int channel, const QByteArray& data,
    */
   auto part_mime = body->getPartAt(0);
 
-  std::ostringstream oss;
-  vmime::utility::outputStreamAdapter osa(oss);
-
   auto part_mime_body = part_mime->getBody();
   auto part_mime_body_content = part_mime_body->getContents();
   if (!part_mime_body_content) {
@@ -1183,11 +1325,9 @@ auto DecryptEMLData(int channel, const QByteArray& data,
     return kEML_FAILED;
   }
 
-  part_mime_body_content->extractRaw(osa);
-  osa.flush();
-
-  auto part_mime_body_content_text = Q_SC(oss.str());
-  FLOG_DEBUG("body part of raw content text: %1", part_mime_body_content_text);
+  auto part_mime_body_content_text = ExtractRawBytes(*part_mime_body_content);
+  FLOG_DEBUG("body part of raw content text: %1",
+             LogPayload(part_mime_body_content_text));
 
   /*
    * A message complying with this
@@ -1217,17 +1357,19 @@ auto DecryptEMLData(int channel, const QByteArray& data,
     return kEML_FAILED;
   }
 
-  auto part_encr_body_content =
-      QByteArray::fromStdString(part_sign->getBody()->generate());
+  auto part_encr_body_content = GenerateEMLBytes(*part_sign->getBody());
   if (part_encr_body_content.trimmed().isEmpty()) {
     eml_data = "The second part is empty";
     return kEML_FAILED;
   }
 
-  FLOG_DEBUG("body part of encrypt content: %1", part_encr_body_content);
+  FLOG_DEBUG("body part of encrypt content: %1",
+             LogPayload(part_encr_body_content));
 
   GFGpgDecryptResult* s;
-  auto ret = GFGpgDecryptData(channel, QDUP(part_encr_body_content), &s);
+  auto ret = WithGpgChannel(channel, [&]() {
+    return GFGpgDecryptData(channel, BDUP(part_encr_body_content), &s);
+  });
 
   eml_data = UDUP(s->decrypted_data);
   err = s->gpgme_error;
@@ -1248,13 +1390,30 @@ auto DecryptEMLData(int channel, const QByteArray& data,
   }
 
   // callback
-  meta_data.from = from_field_value_text;
-  meta_data.to = to_field_value_text.split(',');
-  meta_data.cc = cc_field_value_text.split(',');
-  meta_data.bcc = bcc_field_value_text.split(',');
-  meta_data.subject = subject_field_value_text;
-  meta_data.datetime = date_field_value;
+  meta_data = parsed.meta_data;
   meta_data.encrypted_data = part_encr_body_content;
 
   return kSUCCESS;
+}
+
+auto DecryptEMLData(int channel, const QByteArray& data,
+                    EMailMetaData& meta_data, QString& eml_data,
+                    gpgme_error_t& err, QString& capsule_id) -> int {
+  EMailPGPMIMEStructure structure;
+  if (!ScanPGPMIMEStructure(data, EMailPGPMIMEType::kEncrypted, structure,
+                            eml_data)) {
+    return kEML_FAILED;
+  }
+
+  EMailParsedMessagePtr parsed;
+  try {
+    parsed = ParseEMailMessage(data);
+  } catch (const vmime::exception& e) {
+    FLOG_DEBUG("error when parsing vmime data: %1", e.what());
+    eml_data = "Error when parsing EML Data";
+    return kEML_FAILED;
+  }
+
+  return DecryptEMLMessage(channel, *parsed, meta_data, eml_data, err,
+                           capsule_id);
 }
\ No newline at end of file
@@ -28,6 +28,9 @@
 
 #pragma once
 
+#include <QIODevice>
+
+#include "EMailMessageCache.h"
 #include "EMailModel.h"
 
 //
@@ -40,6 +43,16 @@ enum EMailGpgOperaResult : int8_t {
   kGPG_FAILED = -3,
 };
 
+/**
+ * @brief serialize a message that was built or signed in memory
+ *
+ * @param message
+ * @param eml_data
+ * @return int
+ */
+auto GenerateEMLData(const vmime::shared_ptr<vmime::message>& message,
+                     QString& eml_data) -> int;
+
 /**
  * @brief
  *
@@ -55,6 +68,24 @@ auto EncryptPlainText(int channel, const QStringList& keys,
                       const QByteArray& body_data, QString& eml_data,
                       gpgme_error_t& err, QString& capsule_id) -> int;
 
+/**
+ * @brief like EncryptPlainText, but the message is written straight to the
+ * device instead of being returned as a string
+ *
+ * @param channel
+ * @param keys
+ * @param meta_data
+ * @param body_data
+ * @param device
+ * @param error_string
+ * @return int
+ */
+auto EncryptPlainTextTo(int channel, const QStringList& keys,
+                        const EMailMetaData& meta_data,
+                        const QByteArray& body_data, QIODevice& device,
+                        QString& error_string, gpgme_error_t& err,
+                        QString& capsule_id) -> int;
+
 /**
  * @brief
  *
@@ -69,6 +100,94 @@ auto EncryptEMLData(int channel, const QStringList& keys,
                     const QByteArray& body_data, QString& eml_data,
                     gpgme_error_t& err, QString& capsule_id) -> int;
 
+/**
+ * @brief encrypt a message that only exists in memory (e.g. one just signed
+ * by SignEMLMessage), taking its body from the object graph instead of a
+ * parsed buffer
+ *
+ * @param channel
+ * @param keys
+ * @param message
+ * @param eml_data
+ * @return int
+ */
+auto EncryptEMLMessage(int channel, const QStringList& keys,
+                       const vmime::shared_ptr<vmime::message>& message,
+                       QString& eml_data, gpgme_error_t& err,
+                       QString& capsule_id) -> int;
+
+/**
+ * @brief like EncryptEMLData, but the message is written straight to the
+ * device: headers and boundaries are generated into it and the armored data
+ * is copied in from the GnuPG result, so neither the message nor the
+ * ciphertext is held as a string
+ *
+ * @param channel
+ * @param keys
+ * @param message
+ * @param body_data
+ * @param device
+ * @param error_string
+ * @return int
+ */
+auto EncryptEMLDataTo(int channel, const QStringList& keys,
+                      const vmime::shared_ptr<vmime::message>& message,
+                      const QByteArray& body_data, QIODevice& device,
+                      QString& error_string, gpgme_error_t& err,
+                      QString& capsule_id) -> int;
+
+/**
+ * @brief outcome of the encryption to one recipient key
+ *
+ */
+struct EMailRecipientEML {
+  QString key;
+  int ret = kFAILED;
+  gpgme_error_t err = GPG_ERR_NO_ERROR;
+  QString capsule_id;
+  QString eml_data;  ///< the message, or the error text if ret != kSUCCESS
+};
+
+/**
+ * @brief encrypt the message separately to each key, so no recipient can
+ * see the key IDs of the others (e.g. for Bcc). The multipart/encrypted
+ * envelope is built once and every ciphertext is spliced into it. The
+ * envelope is neutral: Bcc and Cc are dropped and To is
+ * "undisclosed-recipients:;", the encrypted part keeps the original To.
+ *
+ * @param channel
+ * @param keys
+ * @param message
+ * @param body_data
+ * @param results one entry per key, in the order of keys
+ * @param error_string
+ * @return int kSUCCESS once the envelope was built, per-recipient outcomes
+ * are in results
+ */
+auto EncryptEMLDataPerRecipient(
+    int channel, const QStringList& keys,
+    const vmime::shared_ptr<vmime::message>& message,
+    const QByteArray& body_data, QList<EMailRecipientEML>& results,
+    QString& error_string) -> int;
+
+/**
+ * @brief build the multipart/signed message without serializing it
+ *
+ * @param channel
+ * @param key
+ * @param meta_data
+ * @param body_data
+ * @param message
+ * @param error_string
+ * @return int
+ */
+auto SignPlainTextMessage(int channel, const QString& key,
+                          const EMailMetaData& meta_data,
+                          const QByteArray& body_data,
+                          vmime::shared_ptr<vmime::message>& message,
+                          QString& error_string, gpgme_error_t& err,
+                          QString& capsule_id) -> int;
+
 /**
  * @brief
  *
@@ -84,6 +203,21 @@ auto SignPlainText(int channel, const QString& key,
                    QString& eml_data, gpgme_error_t& err, QString& capsule_id)
     -> int;
 
+/**
+ * @brief turn the message into a multipart/signed message in place, without
+ * serializing it
+ *
+ * @param channel
+ * @param key
+ * @param message
+ * @param error_string
+ * @return int
+ */
+auto SignEMLMessage(int channel, const QString& key,
+                    const vmime::shared_ptr<vmime::message>& message,
+                    QString& error_string, gpgme_error_t& err,
+                    QString& capsule_id) -> int;
+
 /**
  * @brief
  *
@@ -98,6 +232,30 @@ auto SignEMLData(int channel, const QString& key,
                  QString& eml_data, gpgme_error_t& err, QString& capsule_id)
     -> int;
 
+/**
+ * @brief check whether a parsed message is a multipart/signed entity, looking
+ * only at its header
+ *
+ * @param parsed
+ * @return true
+ * @return false
+ */
+auto IsSignedEMLMessage(const EMailParsedMessage& parsed) -> bool;
+
+/**
+ * @brief verify a message that was already parsed, e.g. one taken from
+ * EMailMessageCache
+ *
+ * @param channel
+ * @param parsed
+ * @param meta_data
+ * @param error_string
+ * @return int
+ */
+auto VerifyEMLMessage(int channel, const EMailParsedMessage& parsed,
+                      EMailMetaData& meta_data, QString& error_string,
+                      gpgme_error_t& err, QString& capsule_id) -> int;
+
 /**
  * @brief
  *
@@ -109,6 +267,20 @@ auto VerifyEMLData(int channel, const QByteArray& data,
                    EMailMetaData& meta_data, QString& error_string,
                    gpgme_error_t& err, QString& capsule_id) -> int;
 
+/**
+ * @brief decrypt a message that was already parsed, e.g. one taken from
+ * EMailMessageCache
+ *
+ * @param channel
+ * @param parsed
+ * @param meta_data
+ * @param eml_data
+ * @return int
+ */
+auto DecryptEMLMessage(int channel, const EMailParsedMessage& parsed,
+                       EMailMetaData& meta_data, QString& eml_data,
+                       gpgme_error_t& err, QString& capsule_id) -> int;
+
 /**
  * @brief
  *
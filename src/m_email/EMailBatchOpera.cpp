@@ -0,0 +1,364 @@
+/**
+ * Copyright (C) 2021-2026 Saturneric <eric@bktus.com>
+ *
+ * This file is part of GpgFrontend.
+ *
+ * GpgFrontend is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GpgFrontend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GpgFrontend. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The initial version of the source code is inherited from
+ * the gpg4usb project, which is under GPL-3.0-or-later.
+ *
+ * All the source code of GpgFrontend was modified and released by
+ * Saturneric <eric@bktus.com> starting on May 12, 2021.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "EMailBatchOpera.h"
+
+#include <GFSDKGpg.h>
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+#include <utility>
+
+#include "EMailBasicGpgOpera.h"
+#include "EMailGpgChannel.h"
+#include "EMailHelper.h"
+#include "EMailVerifyIndex.h"
+#include "GFModuleCommonUtils.hpp"
+
+namespace {
+
+/**
+ * @brief read only the header block to decide what to do with a message, the
+ * body is left to VerifyEMLData/DecryptEMLData
+ *
+ * @param data
+ * @return QString
+ */
+auto PeekContentType(const QByteArray& data) -> QString {
+  auto header = vmime::make_shared<vmime::header>();
+  try {
+    header->parse(vmime::string(data.constData(), FindEMLHeaderEnd(data)));
+    auto field = header->findField<vmime::contentTypeField>(
+        vmime::fields::CONTENT_TYPE);
+    if (!field) return {};
+    return Q_SC(field->getValue()->generate()).trimmed();
+  } catch (const vmime::exception& e) {
+    FLOG_DEBUG("error when parsing eml header: %1", e.what());
+    return {};
+  }
+}
+
+// trimmed().isEmpty() without the copy
+auto IsBlank(const QByteArray& data) -> bool {
+  return std::all_of(data.cbegin(), data.cend(), [](char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+  });
+}
+
+auto IsQuotedFromLine(const QByteArray& line) -> bool {
+  qsizetype i = 0;
+  while (i < line.size() && line[i] == '>') i++;
+  return i > 0 && line.mid(i, 5) == "From ";
+}
+
+void VerifyMessage(int channel, const QByteArray& data,
+                   EMailBatchResult& result) {
+  EMailMetaData meta_data;
+
+  // outcomes of decrypted inner messages are never written to disk
+  EMailPGPMIMEStructure structure;
+  QString scan_error;
+  const bool indexed =
+      !result.decrypted && ScanPGPMIMEStructure(data, EMailPGPMIMEType::kSigned,
+                                                structure, scan_error);
+  auto& verify_index = EMailVerifyIndex::GetInstance();
+  const auto key =
+      indexed ? EMailVerifyIndex::Key(channel, data, structure) : QString{};
+  EMailVerifyIndexEntry entry;
+  vmime::shared_ptr<vmime::message> header_only;
+  if (indexed && verify_index.Lookup(key, entry) &&
+      CheckIfEMLMessage(data, header_only)) {
+    GetEMLMetaData(header_only, meta_data);
+    result.from = meta_data.from;
+    result.subject = meta_data.subject;
+    result.verify_cards = entry.result_cards;
+    result.result_status = entry.result_status;
+    result.verified = entry.verified;
+    return;
+  }
+
+  QString error_string;
+  gpgme_error_t err;
+  QString capsule_id;
+  auto ret =
+      VerifyEMLData(channel, data, meta_data, error_string, err, capsule_id);
+
+  if (result.from.isEmpty()) result.from = meta_data.from;
+  if (result.subject.isEmpty()) result.subject = meta_data.subject;
+
+  if (ret == kFAILED || ret == kEML_FAILED) {
+    result.result_status = -1;
+    result.error_string = error_string;
+    return;
+  }
+
+  const char* tmp = nullptr;
+  const char* cards_tmp = nullptr;
+  auto status = WithGpgChannel(channel, [&]() {
+    return GFAnalyseVerifyResultByCapsule(channel, err, QDUP(capsule_id), &tmp,
+                                          &cards_tmp);
+  });
+  entry.result_detail = UDUP(tmp);
+  result.verify_cards = UDUP(cards_tmp);
+
+  // an inner signature can only lower the status of the decryption
+  result.result_status =
+      result.decrypted ? std::min(result.result_status, status) : status;
+  result.verified = ret == kSUCCESS;
+  if (ret != kSUCCESS && ret != kGPG_FAILED) {
+    result.result_status = -1;
+    return;
+  }
+  if (!indexed) return;
+
+  entry.result_status = status;
+  entry.verified = result.verified;
+  entry.result_cards = result.verify_cards;
+  entry.signer_fpr = meta_data.signer_fpr;
+  entry.micalg = meta_data.micalg;
+  entry.mime_hash = meta_data.mime_hash;
+  verify_index.Record(key, entry);
+}
+
+void DecryptMessage(int channel, const QByteArray& data,
+                    EMailBatchResult& result) {
+  EMailMetaData meta_data;
+  QString eml_data;
+  gpgme_error_t err;
+  QString capsule_id;
+  auto ret =
+      DecryptEMLData(channel, data, meta_data, eml_data, err, capsule_id);
+
+  result.from = meta_data.from;
+  result.subject = meta_data.subject;
+
+  if (ret == kFAILED || ret == kEML_FAILED) {
+    result.result_status = -1;
+    result.error_string = eml_data;
+    return;
+  }
+
+  const char* tmp = nullptr;
+  const char* cards_tmp = nullptr;
+  result.result_status = WithGpgChannel(channel, [&]() {
+    return GFAnalyseDecryptResultByCapsule(channel, err, QDUP(capsule_id), &tmp,
+                                           &cards_tmp);
+  });
+  UDUP(tmp);
+  result.decrypt_cards = UDUP(cards_tmp);
+
+  if (ret != kSUCCESS) {
+    if (ret != kGPG_FAILED) result.result_status = -1;
+    return;
+  }
+  result.decrypted = true;
+
+  // signed-then-encrypted messages carry a multipart/signed entity inside
+  const auto inner = eml_data.toUtf8();
+  if (PeekContentType(inner) == "multipart/signed") {
+    VerifyMessage(channel, inner, result);
+  }
+}
+
+void ProcessMessage(int channel, const QByteArray& data,
+                    EMailBatchResult& result) {
+  if (data.isEmpty()) {
+    result.error_string = "cannot read message data";
+    return;
+  }
+
+  const auto content_type = PeekContentType(data);
+  if (content_type == "multipart/encrypted") {
+    DecryptMessage(channel, data, result);
+  } else if (content_type == "multipart/signed") {
+    VerifyMessage(channel, data, result);
+  } else {
+    result.skipped = true;
+    result.result_status = 0;
+  }
+}
+
+}  // namespace
+
+auto ScanMBoxFile(const QString& path,
+                  const std::function<bool(QByteArray)>& on_message) -> bool {
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    FLOG_DEBUG("cannot open mbox file: %1", path);
+    return false;
+  }
+
+  QByteArray message;
+  auto flush = [&]() -> bool {
+    if (IsBlank(message)) {
+      message.clear();
+      return true;
+    }
+
+    // the empty line in front of a separator belongs to the mbox format
+    if (message.endsWith("\r\n\r\n")) {
+      message.chop(2);
+    } else if (message.endsWith("\n\n")) {
+      message.chop(1);
+    }
+    return on_message(std::exchange(message, {}));
+  };
+
+  // a separator only counts at the start of the file or after an empty
+  // line, mboxo leaves "From " unescaped inside bodies
+  auto after_empty_line = true;
+  while (!file.atEnd()) {
+    auto line = file.readLine();
+    if (after_empty_line && line.startsWith("From ")) {
+      if (!flush()) return true;
+      after_empty_line = false;
+      continue;
+    }
+
+    after_empty_line = line == "\n" || line == "\r\n";
+    if (IsQuotedFromLine(line)) line.remove(0, 1);
+    message.append(line);
+  }
+
+  flush();
+  return true;
+}
+
+auto ListMaildirMessages(const QString& path) -> QStringList {
+  QStringList files;
+  for (const auto* sub_dir : {"cur", "new"}) {
+    QDirIterator it(QDir(path).filePath(sub_dir), QDir::Files);
+    while (it.hasNext()) files.append(it.next());
+  }
+
+  // maildir file names start with the delivery time
+  std::sort(files.begin(), files.end(),
+            [](const QString& a, const QString& b) {
+              return QFileInfo(a).fileName() < QFileInfo(b).fileName();
+            });
+  return files;
+}
+
+auto BatchVerifyDecryptEMails(int channel, const QString& path,
+                              int max_threads,
+                              const EMailBatchCancelFlag& cancel_flag,
+                              const EMailBatchProgressCallback& progress,
+                              QList<EMailBatchResult>& results,
+                              EMailBatchSummary& summary) -> int {
+  QFileInfo info(path);
+  if (!info.exists()) return kFAILED;
+
+  auto is_cancelled = [&]() -> bool {
+    return cancel_flag != nullptr && cancel_flag->load();
+  };
+
+  // the caller's count is a wish, it never goes past one worker per core
+  const auto ideal_threads = QThread::idealThreadCount();
+  QThreadPool pool;
+  pool.setMaxThreadCount(max_threads > 0 ? std::min(max_threads, ideal_threads)
+                                         : ideal_threads);
+
+  // keep at most two messages per worker in memory while scanning
+  QSemaphore free_slots(pool.maxThreadCount() * 2);
+
+  QMutex mutex;
+  QList<EMailBatchResult> collected;
+  std::atomic<qsizetype> scanned{0};
+  std::atomic<qsizetype> done{0};
+
+  auto submit = [&](const QString& source,
+                    const std::function<QByteArray()>& load) -> bool {
+    if (is_cancelled()) return false;
+
+    free_slots.acquire();
+    const auto index = scanned++;
+    pool.start([&, index, source, load]() {
+      if (!is_cancelled()) {
+        EMailBatchResult result;
+        result.index = index;
+        result.source = source;
+        ProcessMessage(channel, load(), result);
+
+        QMutexLocker locker(&mutex);
+        collected.append(std::move(result));
+      }
+      free_slots.release();
+
+      const auto finished = ++done;
+      if (progress) progress(finished, scanned.load());
+    });
+    return true;
+  };
+
+  bool ret = true;
+  if (info.isDir()) {
+    for (const auto& file_path : ListMaildirMessages(path)) {
+      auto loaded = submit(file_path, [file_path]() -> QByteArray {
+        QFile file(file_path);
+        return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray{};
+      });
+      if (!loaded) break;
+    }
+  } else {
+    ret = ScanMBoxFile(path, [&](QByteArray message) -> bool {
+      return submit(QString("mbox#%1").arg(scanned.load() + 1),
+                    [message]() -> QByteArray { return message; });
+    });
+  }
+
+  pool.waitForDone();
+  EMailVerifyIndex::GetInstance().Save();
+
+  std::sort(collected.begin(), collected.end(),
+            [](const EMailBatchResult& a, const EMailBatchResult& b) {
+              return a.index < b.index;
+            });
+
+  summary = {};
+  for (const auto& result : collected) {
+    summary.total++;
+    if (result.skipped) {
+      summary.skipped++;
+      continue;
+    }
+    if (result.decrypted) summary.decrypted++;
+    if (result.verified) summary.verified++;
+    if (result.result_status < 0) summary.failed++;
+  }
+  summary.cancelled = is_cancelled();
+
+  results = std::move(collected);
+  return ret ? kSUCCESS : kFAILED;
+}
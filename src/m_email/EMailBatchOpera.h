@@ -0,0 +1,119 @@
+/**
+ * Copyright (C) 2021-2026 Saturneric <eric@bktus.com>
+ *
+ * This file is part of GpgFrontend.
+ *
+ * GpgFrontend is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GpgFrontend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GpgFrontend. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The initial version of the source code is inherited from
+ * the gpg4usb project, which is under GPL-3.0-or-later.
+ *
+ * All the source code of GpgFrontend was modified and released by
+ * Saturneric <eric@bktus.com> starting on May 12, 2021.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+/**
+ * @brief outcome of one message of a batch run
+ *
+ */
+struct EMailBatchResult {
+  qsizetype index = 0;  ///< position of the message in the mailbox
+  QString source;       ///< Maildir file path, or "mbox#<n>"
+  QString from;
+  QString subject;
+  bool decrypted = false;
+  bool verified = false;
+  bool skipped = false;  ///< not a PGP/MIME message
+  int result_status = -1;
+  QString error_string;
+  QString decrypt_cards;  ///< JSON array from GFAnalyseDecryptResultByCapsule
+  QString verify_cards;   ///< JSON array from GFAnalyseVerifyResultByCapsule
+};
+
+/**
+ * @brief totals of a batch run
+ *
+ */
+struct EMailBatchSummary {
+  qsizetype total = 0;
+  qsizetype decrypted = 0;
+  qsizetype verified = 0;
+  qsizetype skipped = 0;
+  qsizetype failed = 0;
+  bool cancelled = false;
+};
+
+using EMailBatchCancelFlag = std::shared_ptr<std::atomic_bool>;
+
+/**
+ * @brief called from worker threads after each message is done. total grows
+ * while an mbox is still being scanned.
+ *
+ */
+using EMailBatchProgressCallback =
+    std::function<void(qsizetype done, qsizetype total)>;
+
+/**
+ * @brief split an mbox file into messages without loading it as a whole.
+ * Separator lines are dropped and mboxrd ">From " quoting is undone. Stops
+ * early when on_message returns false.
+ *
+ * @param path
+ * @param on_message
+ * @return true
+ * @return false
+ */
+auto ScanMBoxFile(const QString& path,
+                  const std::function<bool(QByteArray)>& on_message) -> bool;
+
+/**
+ * @brief list the message files under cur/ and new/ of a Maildir
+ *
+ * @param path
+ * @return QStringList
+ */
+auto ListMaildirMessages(const QString& path) -> QStringList;
+
+/**
+ * @brief verify and decrypt every PGP/MIME message of an mbox file or Maildir
+ * directory on a bounded worker pool. All GnuPG work is done on channel.
+ * Results are returned in mailbox order.
+ *
+ * @param channel
+ * @param path
+ * @param max_threads 0 picks the ideal thread count, larger values are
+ * clamped to it
+ * @param cancel_flag may be null
+ * @param progress may be empty
+ * @param results
+ * @param summary
+ * @return int
+ */
+auto BatchVerifyDecryptEMails(int channel, const QString& path,
+                              int max_threads,
+                              const EMailBatchCancelFlag& cancel_flag,
+                              const EMailBatchProgressCallback& progress,
+                              QList<EMailBatchResult>& results,
+                              EMailBatchSummary& summary) -> int;
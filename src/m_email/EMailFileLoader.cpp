@@ -0,0 +1,181 @@
+/**
+ * Copyright (C) 2021-2026 Saturneric <eric@bktus.com>
+ *
+ * This file is part of GpgFrontend.
+ *
+ * GpgFrontend is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GpgFrontend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GpgFrontend. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The initial version of the source code is inherited from
+ * the gpg4usb project, which is under GPL-3.0-or-later.
+ *
+ * All the source code of GpgFrontend was modified and released by
+ * Saturneric <eric@bktus.com> starting on May 12, 2021.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "EMailFileLoader.h"
+
+#include <QPlainTextEdit>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTimer>
+#include <algorithm>
+#include <cstring>
+
+#include "GFModuleCommonUtils.hpp"
+
+EMailFileLoader::EMailFileLoader(const QString& file_path,
+                                 QPlainTextEdit* text_edit, QObject* parent)
+    : QObject(parent), file_(file_path), text_edit_(text_edit) {}
+
+auto EMailFileLoader::Start() -> bool {
+  if (text_edit_.isNull()) {
+    error_string_ = "text editor is not available";
+    return false;
+  }
+
+  if (!file_.open(QIODevice::ReadOnly)) {
+    error_string_ = file_.errorString();
+    return false;
+  }
+
+  size_ = file_.size();
+
+  // mapping may fail on some file systems, reading in chunks is the fallback
+  if (size_ > 0) mapped_ = file_.map(0, size_);
+
+  FLOG_DEBUG("start loading eml file: %1, size: %2", file_.fileName(), size_);
+
+  auto* document = text_edit_->document();
+  undo_redo_enabled_ = document->isUndoRedoEnabled();
+  document->setUndoRedoEnabled(false);
+
+  // user edits must not interleave with the appended chunks
+  read_only_ = text_edit_->isReadOnly();
+  text_edit_->setReadOnly(true);
+  text_edit_->clear();
+
+  QTimer::singleShot(0, this, &EMailFileLoader::slot_load_next_chunk);
+  return true;
+}
+
+auto EMailFileLoader::ErrorString() const -> QString { return error_string_; }
+
+void EMailFileLoader::slot_load_next_chunk() {
+  if (text_edit_.isNull()) {
+    error_string_ = "text editor was closed during loading";
+    if (mapped_ != nullptr) file_.unmap(mapped_);
+    file_.close();
+    emit SignalLoadFailed(error_string_);
+    deleteLater();
+    return;
+  }
+
+  const auto length = std::min(kChunkSize, size_ - offset_);
+  const bool last = offset_ + length >= size_;
+
+  QByteArray chunk;
+  if (mapped_ != nullptr) {
+    chunk = normalize_chunk(reinterpret_cast<const char*>(mapped_ + offset_),
+                            length, last);
+  } else {
+    auto buffer = file_.read(length);
+    if (buffer.size() != length) {
+      error_string_ = file_.errorString();
+      file_.close();
+      text_edit_->setReadOnly(read_only_);
+      text_edit_->document()->setUndoRedoEnabled(undo_redo_enabled_);
+      emit SignalLoadFailed(error_string_);
+      deleteLater();
+      return;
+    }
+    chunk = normalize_chunk(buffer.constData(), buffer.size(), last);
+  }
+
+  offset_ += length;
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+  const QString text = decoder_.decode(chunk);
+#else
+  const QString text = decoder_->toUnicode(chunk);
+#endif
+
+  QTextCursor cursor(text_edit_->document());
+  cursor.movePosition(QTextCursor::End);
+  cursor.insertText(text);
+
+  if (last) {
+    finish_loading();
+    return;
+  }
+
+  QTimer::singleShot(0, this, &EMailFileLoader::slot_load_next_chunk);
+}
+
+auto EMailFileLoader::normalize_chunk(const char* data, qint64 size, bool last)
+    -> QByteArray {
+  QByteArray out;
+  out.reserve(static_cast<qsizetype>(size) + 1);
+
+  const char* p = data;
+  const char* end = data + size;
+
+  if (pending_cr_) {
+    pending_cr_ = false;
+    if (p == end || *p != '\n') out.append('\r');
+  }
+
+  while (p < end) {
+    const auto* cr = static_cast<const char*>(std::memchr(p, '\r', end - p));
+    if (cr == nullptr) {
+      out.append(p, static_cast<qsizetype>(end - p));
+      break;
+    }
+
+    out.append(p, static_cast<qsizetype>(cr - p));
+
+    if (cr + 1 < end) {
+      // only CRLF is folded, a lone CR is kept as it is
+      if (cr[1] != '\n') out.append('\r');
+    } else if (last) {
+      out.append('\r');
+    } else {
+      pending_cr_ = true;
+    }
+
+    p = cr + 1;
+  }
+
+  return out;
+}
+
+void EMailFileLoader::finish_loading() {
+  if (mapped_ != nullptr) {
+    file_.unmap(mapped_);
+    mapped_ = nullptr;
+  }
+  file_.close();
+
+  auto* document = text_edit_->document();
+  document->setUndoRedoEnabled(undo_redo_enabled_);
+  document->setModified(false);
+  text_edit_->setReadOnly(read_only_);
+
+  FLOG_DEBUG("eml file loaded: %1, size: %2", file_.fileName(), size_);
+
+  emit SignalLoadFinished();
+  deleteLater();
+}
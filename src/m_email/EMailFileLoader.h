@@ -0,0 +1,138 @@
+/**
+ * Copyright (C) 2021-2026 Saturneric <eric@bktus.com>
+ *
+ * This file is part of GpgFrontend.
+ *
+ * GpgFrontend is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GpgFrontend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GpgFrontend. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The initial version of the source code is inherited from
+ * the gpg4usb project, which is under GPL-3.0-or-later.
+ *
+ * All the source code of GpgFrontend was modified and released by
+ * Saturneric <eric@bktus.com> starting on May 12, 2021.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <QFile>
+#include <QObject>
+#include <QPointer>
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+#include <QStringDecoder>
+#else
+#include <QTextCodec>
+#include <QTextDecoder>
+#endif
+
+class QPlainTextEdit;
+
+/**
+ * @brief Loads an EML file into a text editor chunk by chunk.
+ *
+ * The file is memory-mapped when possible (falling back to buffered reads),
+ * CRLF line endings are folded to LF per chunk, and each chunk is appended to
+ * the editor from the event loop so the GUI stays responsive and the loader
+ * never holds more than one chunk of the file in memory.
+ */
+class EMailFileLoader : public QObject {
+  Q_OBJECT
+ public:
+  /**
+   * @brief Construct a new EMailFileLoader object
+   *
+   * @param file_path
+   * @param text_edit
+   * @param parent
+   */
+  EMailFileLoader(const QString& file_path, QPlainTextEdit* text_edit,
+                  QObject* parent = nullptr);
+
+  /**
+   * @brief open the file and schedule the first chunk
+   *
+   * @return true
+   * @return false
+   */
+  auto Start() -> bool;
+
+  /**
+   * @brief
+   *
+   * @return QString
+   */
+  [[nodiscard]] auto ErrorString() const -> QString;
+
+ signals:
+
+  /**
+   * @brief emitted after the last chunk was appended
+   *
+   */
+  void SignalLoadFinished();
+
+  /**
+   * @brief
+   *
+   * @param error_string
+   */
+  void SignalLoadFailed(QString error_string);
+
+ private slots:
+
+  /**
+   * @brief
+   *
+   */
+  void slot_load_next_chunk();
+
+ private:
+  /**
+   * @brief fold CRLF to LF, carrying a trailing CR over to the next chunk
+   *
+   * @param data
+   * @param size
+   * @param last
+   * @return QByteArray
+   */
+  auto normalize_chunk(const char* data, qint64 size, bool last) -> QByteArray;
+
+  /**
+   * @brief
+   *
+   */
+  void finish_loading();
+
+  QFile file_;
+  QPointer<QPlainTextEdit> text_edit_;
+  uchar* mapped_ = nullptr;
+  qint64 size_ = 0;
+  qint64 offset_ = 0;
+  bool pending_cr_ = false;
+  bool undo_redo_enabled_ = true;
+  bool read_only_ = false;
+  QString error_string_;
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+  QStringDecoder decoder_{QStringDecoder::Utf8};
+#else
+  QScopedPointer<QTextDecoder> decoder_{
+      QTextCodec::codecForName("UTF-8")->makeDecoder()};
+#endif
+
+  static constexpr qint64 kChunkSize = 1024 * 1024;
+};
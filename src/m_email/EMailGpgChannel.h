@@ -0,0 +1,75 @@
+/**
+ * Copyright (C) 2021-2026 Saturneric <eric@bktus.com>
+ *
+ * This file is part of GpgFrontend.
+ *
+ * GpgFrontend is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GpgFrontend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GpgFrontend. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The initial version of the source code is inherited from
+ * the gpg4usb project, which is under GPL-3.0-or-later.
+ *
+ * All the source code of GpgFrontend was modified and released by
+ * Saturneric <eric@bktus.com> starting on May 12, 2021.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <QMutex>
+
+/**
+ * @brief Serializes GnuPG access per channel. Nothing in the SDK promises
+ * that the context behind a channel may be used from several threads at
+ * once, while the batch, live and fan-out paths all run on worker threads.
+ * Parsing and MIME work stay parallel, only the GFGpg* and GFAnalyse* calls
+ * are serialized.
+ *
+ */
+class EMailGpgChannelLock {
+ public:
+  /**
+   * @brief lock the channel until the object goes out of scope
+   *
+   * @param channel
+   */
+  explicit EMailGpgChannelLock(int channel);
+
+  /**
+   * @brief Destroy the EMailGpgChannelLock object, unlocking the channel
+   *
+   */
+  ~EMailGpgChannelLock();
+
+  EMailGpgChannelLock(const EMailGpgChannelLock&) = delete;
+  auto operator=(const EMailGpgChannelLock&) -> EMailGpgChannelLock& = delete;
+
+ private:
+  QMutex* mutex_;
+};
+
+/**
+ * @brief run one GnuPG call with the channel locked
+ *
+ * @tparam F
+ * @param channel
+ * @param f
+ * @return decltype(f())
+ */
+template <typename F>
+auto WithGpgChannel(int channel, F&& f) -> decltype(f()) {
+  EMailGpgChannelLock lock(channel);
+  return f();
+}
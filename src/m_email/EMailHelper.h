@@ -29,6 +29,7 @@
 #pragma once
 
 #include <QDateTime>
+#include <QIODevice>
 #include <QString>
 
 #include "EMailModel.h"
@@ -97,6 +98,17 @@ auto ExtractFieldValueAddressList(
 auto ExtractFieldValueDateTime(const vmime::shared_ptr<vmime::header>& header,
                                const QString& field_name) -> QDateTime;
 
+/**
+ * @brief fill the From, To, Cc, Bcc, Subject and Date entries of meta_data
+ * in a single walk over the header fields; other fields are skipped by name
+ * and never decoded, and missing fields are not added to the header
+ *
+ * @param header
+ * @param meta_data
+ */
+void ExtractEMLMetaData(const vmime::shared_ptr<vmime::header>& header,
+                        EMailMetaData& meta_data);
+
 /**
  * @brief
  *
@@ -120,7 +132,17 @@ auto EncodeBase64WithLineBreaks(const QByteArray& data,
                                 int lineLength = 76) -> QString;
 
 /**
- * @brief
+ * @brief offset of the empty line that ends the header block, or the size of
+ * data if there is none
+ *
+ * @param data
+ * @return qsizetype
+ */
+auto FindEMLHeaderEnd(const QByteArray& data) -> qsizetype;
+
+/**
+ * @brief parse only the header block of data into message. The body stays
+ * empty until ParseEMLBody is called.
  *
  * @param data
  * @return true
@@ -129,6 +151,95 @@ auto EncodeBase64WithLineBreaks(const QByteArray& data,
 auto CheckIfEMLMessage(const QByteArray& data,
                        vmime::shared_ptr<vmime::message>& message) -> bool;
 
+/**
+ * @brief complete a message checked by CheckIfEMLMessage, parsing it in place
+ * so data must outlive message
+ *
+ * @param data
+ * @param message
+ * @param error_string
+ * @return true
+ * @return false
+ */
+auto ParseEMLBody(const QByteArray& data,
+                  const vmime::shared_ptr<vmime::message>& message,
+                  QString& error_string) -> bool;
+
+/**
+ * @brief parse the message straight from the buffer instead of a vmime::string
+ * copy. Body contents are parsed as views into data, so data must outlive
+ * message. Throws vmime::exception on malformed input.
+ *
+ * @param data
+ * @param message
+ */
+void ParseEMLMessageInPlace(const QByteArray& data,
+                            const vmime::shared_ptr<vmime::message>& message);
+
+/**
+ * @brief serialize a component straight into UTF-8 bytes, without going
+ * through std::string or QString
+ *
+ * @param component
+ * @param max_line_length
+ * @return QByteArray
+ */
+auto GenerateEMLBytes(
+    const vmime::component& component,
+    size_t max_line_length = vmime::lineLengthLimits::infinite) -> QByteArray;
+
+/**
+ * @brief generate a component straight into a device, without the whole
+ * message ever being held in memory. If placeholder is given, its first
+ * occurrence is replaced by replacement while writing, e.g. to put a
+ * ciphertext in place of a marker instead of copying it into the object
+ * graph.
+ *
+ * @param component
+ * @param device
+ * @param max_line_length
+ * @param placeholder
+ * @param replacement
+ * @return true if everything was written and the placeholder was found
+ * @return false
+ */
+auto GenerateEMLTo(const vmime::component& component, QIODevice& device,
+                   size_t max_line_length = vmime::lineLengthLimits::infinite,
+                   const QByteArray& placeholder = {},
+                   const QByteArray& replacement = {}) -> bool;
+
+/**
+ * @brief the still encoded content of a body, as bytes
+ *
+ * @param content
+ * @return QByteArray
+ */
+auto ExtractRawBytes(const vmime::contentHandler& content) -> QByteArray;
+
+/**
+ * @brief decode every application/pgp-keys attachment below part straight
+ * into keys, chunk by chunk and without intermediate strings. Throws
+ * vmime::exception on broken parts.
+ *
+ * @param part
+ * @param keys
+ * @return int number of attachments found
+ */
+auto ExtractPublicKeyAttachments(
+    const vmime::shared_ptr<const vmime::bodyPart>& part, QByteArray& keys)
+    -> int;
+
+/**
+ * @brief read-only view of a parsed region of data, no bytes are copied
+ *
+ * @param data
+ * @param offset
+ * @param length
+ * @return QByteArray
+ */
+auto ByteArrayView(const QByteArray& data, size_t offset,
+                   size_t length) -> QByteArray;
+
 /**
  * @brief
  *
@@ -0,0 +1,130 @@
+/**
+ * Copyright (C) 2021-2026 Saturneric <eric@bktus.com>
+ *
+ * This file is part of GpgFrontend.
+ *
+ * GpgFrontend is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GpgFrontend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GpgFrontend. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The initial version of the source code is inherited from
+ * the gpg4usb project, which is under GPL-3.0-or-later.
+ *
+ * All the source code of GpgFrontend was modified and released by
+ * Saturneric <eric@bktus.com> starting on May 12, 2021.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "EMailKeyringCache.h"
+
+#include <GFSDKGpg.h>
+
+#include <QDateTime>
+#include <sstream>
+
+#include "EMailGpgChannel.h"
+#include "GFModuleCommonUtils.hpp"
+
+auto EMailKeyringCache::GetInstance() -> EMailKeyringCache& {
+  static EMailKeyringCache instance;
+  return instance;
+}
+
+auto EMailKeyringCache::PublicKeyContent(int channel, const QString& key)
+    -> vmime::shared_ptr<const vmime::contentHandler> {
+  const auto now = QDateTime::currentMSecsSinceEpoch();
+  {
+    QMutexLocker locker(&mutex_);
+    const auto& keys = public_keys_[channel];
+    auto it = keys.constFind(key);
+    if (it != keys.constEnd() && it->expires_at > now) return it->content;
+  }
+
+  auto public_key = UDUP(WithGpgChannel(
+      channel, [&]() { return GFGpgPublicKey(channel, QDUP(key), 1); }));
+  if (public_key.isEmpty()) return nullptr;
+
+  public_key.replace("\r\n", "\n");
+  public_key.replace("\n", "\r\n");
+
+  // encode once here rather than every time a message is generated
+  vmime::stringContentHandler raw_content(public_key.toLatin1().toStdString());
+  std::ostringstream oss;
+  vmime::utility::outputStreamAdapter osa(oss);
+  raw_content.generate(
+      osa, vmime::encoding(vmime::encodingTypes::QUOTED_PRINTABLE),
+      vmime::lineLengthLimits::convenient);
+  osa.flush();
+
+  vmime::shared_ptr<const vmime::contentHandler> content =
+      vmime::make_shared<vmime::stringContentHandler>(
+          oss.str(), vmime::encoding(vmime::encodingTypes::QUOTED_PRINTABLE));
+
+  QMutexLocker locker(&mutex_);
+  public_keys_[channel].insert(key, {content, now + kTTL});
+  return content;
+}
+
+auto EMailKeyringCache::PrimaryUIDs(int channel, const QStringList& keys)
+    -> QHash<QString, EMailKeyUID> {
+  const auto now = QDateTime::currentMSecsSinceEpoch();
+
+  QHash<QString, EMailKeyUID> result;
+  QStringList missing;
+  {
+    QMutexLocker locker(&mutex_);
+    const auto& uids = uids_[channel];
+    for (const auto& key : keys) {
+      if (key.isEmpty() || result.contains(key)) continue;
+
+      auto it = uids.constFind(key);
+      if (it != uids.constEnd() && it->expires_at > now) {
+        result.insert(key, it->uid);
+      } else if (!missing.contains(key)) {
+        missing.append(key);
+      }
+    }
+  }
+  if (missing.isEmpty()) return result;
+
+  // the SDK resolves one key per call, so at least do all of them without
+  // taking the lock in between
+  QHash<QString, EMailKeyUID> resolved;
+  for (const auto& key : missing) {
+    GFGpgKeyUID* s = nullptr;
+    auto ret = WithGpgChannel(
+        channel, [&]() { return GFGpgKeyPrimaryUID(channel, QDUP(key), &s); });
+    if (ret != 0 || s == nullptr) {
+      FLOG_WARN("cannot get primary uid from key %1", key);
+      continue;
+    }
+
+    resolved.insert(key, {UDUP(s->name), UDUP(s->email), UDUP(s->comment)});
+    GFFreeMemory(s);
+  }
+
+  QMutexLocker locker(&mutex_);
+  auto& uids = uids_[channel];
+  for (auto it = resolved.constBegin(); it != resolved.constEnd(); ++it) {
+    uids.insert(it.key(), {it.value(), now + kTTL});
+    result.insert(it.key(), it.value());
+  }
+  return result;
+}
+
+void EMailKeyringCache::Invalidate() {
+  QMutexLocker locker(&mutex_);
+  public_keys_.clear();
+  uids_.clear();
+}
@@ -0,0 +1,106 @@
+/**
+ * Copyright (C) 2021-2026 Saturneric <eric@bktus.com>
+ *
+ * This file is part of GpgFrontend.
+ *
+ * GpgFrontend is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GpgFrontend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GpgFrontend. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The initial version of the source code is inherited from
+ * the gpg4usb project, which is under GPL-3.0-or-later.
+ *
+ * All the source code of GpgFrontend was modified and released by
+ * Saturneric <eric@bktus.com> starting on May 12, 2021.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+
+#include "EMailModel.h"
+
+struct EMailKeyUID {
+  QString name;
+  QString email;
+  QString comment;
+};
+
+/**
+ * @brief Per-channel cache of keyring lookups made while building messages.
+ *
+ * Entries are dropped by Invalidate(), which the module calls whenever the
+ * keyring changes, and expire after a few minutes in case a change went by
+ * unnoticed.
+ */
+class EMailKeyringCache {
+ public:
+  /**
+   * @brief Get the Instance object
+   *
+   * @return EMailKeyringCache&
+   */
+  static auto GetInstance() -> EMailKeyringCache&;
+
+  /**
+   * @brief the armored public key of key, already quoted-printable encoded
+   * as the body of an application/pgp-keys part. Null if the key cannot be
+   * exported. Throws vmime::exception if encoding fails.
+   *
+   * @param channel
+   * @param key
+   * @return vmime::shared_ptr<const vmime::contentHandler>
+   */
+  auto PublicKeyContent(int channel, const QString& key)
+      -> vmime::shared_ptr<const vmime::contentHandler>;
+
+  /**
+   * @brief primary UIDs of keys. Keys missing from the cache are looked up
+   * in one pass and stored together; keys without a UID are left out of the
+   * result.
+   *
+   * @param channel
+   * @param keys
+   * @return QHash<QString, EMailKeyUID>
+   */
+  auto PrimaryUIDs(int channel, const QStringList& keys)
+      -> QHash<QString, EMailKeyUID>;
+
+  /**
+   * @brief forget everything on every channel
+   *
+   */
+  void Invalidate();
+
+ private:
+  struct PublicKeyEntry {
+    vmime::shared_ptr<const vmime::contentHandler> content;
+    qint64 expires_at;
+  };
+
+  struct UIDEntry {
+    EMailKeyUID uid;
+    qint64 expires_at;
+  };
+
+  QMutex mutex_;
+  QMap<int, QHash<QString, PublicKeyEntry>> public_keys_;
+  QMap<int, QHash<QString, UIDEntry>> uids_;
+
+  static constexpr qint64 kTTL = 5 * 60 * 1000;
+};
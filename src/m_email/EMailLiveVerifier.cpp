@@ -0,0 +1,217 @@
+/**
+ * Copyright (C) 2021-2026 Saturneric <eric@bktus.com>
+ *
+ * This file is part of GpgFrontend.
+ *
+ * GpgFrontend is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GpgFrontend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GpgFrontend. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The initial version of the source code is inherited from
+ * the gpg4usb project, which is under GPL-3.0-or-later.
+ *
+ * All the source code of GpgFrontend was modified and released by
+ * Saturneric <eric@bktus.com> starting on May 12, 2021.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "EMailLiveVerifier.h"
+
+#include <QApplication>
+#include <QEvent>
+#include <QLabel>
+#include <QPlainTextEdit>
+#include <QScrollBar>
+#include <QSet>
+#include <QThreadPool>
+
+#include "EMailBasicGpgOpera.h"
+#include "EMailGpgChannel.h"
+#include "EMailPGPMIMEScanner.h"
+#include "GFModuleCommonUtils.hpp"
+
+namespace {
+
+// live verifiers of the open tabs, only touched on the GUI thread
+auto LiveVerifiers() -> QSet<EMailLiveVerifier*>& {
+  static QSet<EMailLiveVerifier*> verifiers;
+  return verifiers;
+}
+
+auto VerifyInBackground(int channel, const QByteArray& data,
+                        QString& result_detail) -> int {
+  EMailMetaData meta_data;
+  QString error_string;
+  gpgme_error_t err;
+  QString capsule_id;
+  auto ret =
+      VerifyEMLData(channel, data, meta_data, error_string, err, capsule_id);
+  if (ret == kFAILED || ret == kEML_FAILED) {
+    result_detail = error_string;
+    return -1;
+  }
+
+  const char* tmp = nullptr;
+  const char* cards_tmp = nullptr;
+  auto status = WithGpgChannel(channel, [&]() {
+    return GFAnalyseVerifyResultByCapsule(channel, err, QDUP(capsule_id), &tmp,
+                                          &cards_tmp);
+  });
+  result_detail = UDUP(tmp);
+  UDUP(cards_tmp);
+  return ret == kSUCCESS || ret == kGPG_FAILED ? status : -1;
+}
+
+}  // namespace
+
+EMailLiveVerifier::EMailLiveVerifier(int channel, QPlainTextEdit* text_edit,
+                                     QObject* parent)
+    : QObject(parent),
+      channel_(channel),
+      text_edit_(text_edit),
+      label_(new QLabel(text_edit)) {
+  label_->setMargin(4);
+  label_->hide();
+
+  debounce_.setSingleShot(true);
+  debounce_.setInterval(kDebounceMs);
+  connect(&debounce_, &QTimer::timeout, this, &EMailLiveVerifier::slot_check);
+  connect(text_edit, &QPlainTextEdit::textChanged, &debounce_,
+          qOverload<>(&QTimer::start));
+
+  text_edit->installEventFilter(this);
+  LiveVerifiers().insert(this);
+  debounce_.start();
+}
+
+EMailLiveVerifier::~EMailLiveVerifier() { LiveVerifiers().remove(this); }
+
+void EMailLiveVerifier::RecheckAll() {
+  QMetaObject::invokeMethod(
+      QCoreApplication::instance(),
+      []() {
+        for (auto* verifier : LiveVerifiers()) verifier->recheck();
+      },
+      Qt::QueuedConnection);
+}
+
+void EMailLiveVerifier::recheck() {
+  generation_++;
+  region_hash_.clear();
+  debounce_.start();
+}
+
+auto EMailLiveVerifier::eventFilter(QObject* watched, QEvent* event) -> bool {
+  if (watched == text_edit_ && event->type() == QEvent::Resize) {
+    place_label();
+  }
+  return QObject::eventFilter(watched, event);
+}
+
+void EMailLiveVerifier::slot_check() {
+  if (text_edit_.isNull()) return;
+
+  // one check at a time, edits made meanwhile are picked up afterwards
+  if (running_) {
+    pending_ = true;
+    return;
+  }
+  running_ = true;
+
+  const auto data = text_edit_->toPlainText().toUtf8();
+  const auto last_hash = region_hash_;
+  const auto channel = channel_;
+  const auto generation = generation_;
+  QPointer<EMailLiveVerifier> self(this);
+
+  QThreadPool::globalInstance()->start([=]() {
+    EMailPGPMIMEStructure structure;
+    QString error_string;
+    QByteArray hash;
+    int result_status = -1;
+    QString result_detail;
+
+    if (ScanPGPMIMEStructure(data, EMailPGPMIMEType::kSigned, structure,
+                             error_string)) {
+      hash = HashPGPMIMESignedRegion(data, structure);
+      if (hash != last_hash) {
+        FLOG_DEBUG("signed region changed, verifying %1 bytes", data.size());
+        result_status = VerifyInBackground(channel, data, result_detail);
+      }
+    }
+
+    QMetaObject::invokeMethod(
+        QCoreApplication::instance(),
+        [=]() {
+          if (self) {
+            self->on_checked(generation, hash, result_status, result_detail);
+          }
+        },
+        Qt::QueuedConnection);
+  });
+}
+
+void EMailLiveVerifier::on_checked(int generation,
+                                   const QByteArray& region_hash,
+                                   int result_status,
+                                   const QString& result_detail) {
+  running_ = false;
+  if (pending_) {
+    pending_ = false;
+    debounce_.start();
+  }
+
+  // started before recheck(), recheck() already queued a new one
+  if (generation != generation_) return;
+
+  if (region_hash == region_hash_ || label_.isNull()) return;
+  region_hash_ = region_hash;
+
+  if (region_hash.isEmpty()) {
+    label_->hide();
+    return;
+  }
+
+  QString text;
+  QString color;
+  if (result_status > 0) {
+    text = QApplication::translate("EMailModule", "Signature: Verified");
+    color = "#2e7d32";
+  } else if (result_status == 0) {
+    text = QApplication::translate("EMailModule", "Signature: Warning");
+    color = "#ef6c00";
+  } else {
+    text = QApplication::translate("EMailModule", "Signature: Invalid");
+    color = "#c62828";
+  }
+
+  label_->setText(text);
+  label_->setToolTip(result_detail);
+  label_->setStyleSheet(
+      QString("QLabel { color: white; background: %1; border-radius: 3px; }")
+          .arg(color));
+  label_->adjustSize();
+  place_label();
+  label_->show();
+}
+
+void EMailLiveVerifier::place_label() {
+  if (text_edit_.isNull() || label_.isNull()) return;
+
+  auto right = text_edit_->width() - label_->width() - 8;
+  auto* scroll_bar = text_edit_->verticalScrollBar();
+  if (scroll_bar->isVisible()) right -= scroll_bar->width();
+  label_->move(right, 8);
+  label_->raise();
+}
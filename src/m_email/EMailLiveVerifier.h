@@ -0,0 +1,128 @@
+/**
+ * Copyright (C) 2021-2026 Saturneric <eric@bktus.com>
+ *
+ * This file is part of GpgFrontend.
+ *
+ * GpgFrontend is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GpgFrontend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GpgFrontend. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The initial version of the source code is inherited from
+ * the gpg4usb project, which is under GPL-3.0-or-later.
+ *
+ * All the source code of GpgFrontend was modified and released by
+ * Saturneric <eric@bktus.com> starting on May 12, 2021.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+
+class QLabel;
+class QPlainTextEdit;
+
+/**
+ * @brief Re-verifies the signature of an email tab in the background while
+ * it is edited.
+ *
+ * Edits are debounced, then the tab text is scanned on a worker thread with
+ * ScanPGPMIMEStructure. Only when the hash of the signed part and the
+ * signature changed is the message verified again, so typing in headers or
+ * in an unsigned message never reaches GnuPG. The outcome is shown in a small
+ * label in the corner of the editor.
+ */
+class EMailLiveVerifier : public QObject {
+  Q_OBJECT
+ public:
+  /**
+   * @brief Construct a new EMailLiveVerifier object
+   *
+   * @param channel
+   * @param text_edit
+   * @param parent
+   */
+  EMailLiveVerifier(int channel, QPlainTextEdit* text_edit,
+                    QObject* parent = nullptr);
+
+  /**
+   * @brief Destroy the EMailLiveVerifier object
+   *
+   */
+  ~EMailLiveVerifier() override;
+
+  /**
+   * @brief forget the last outcome of every live verifier and check again,
+   * e.g. after the keyring changed. May be called from any thread.
+   *
+   */
+  static void RecheckAll();
+
+ protected:
+  /**
+   * @brief keep the status label in the corner of the editor
+   *
+   * @param watched
+   * @param event
+   * @return true
+   * @return false
+   */
+  auto eventFilter(QObject* watched, QEvent* event) -> bool override;
+
+ private slots:
+
+  /**
+   * @brief
+   *
+   */
+  void slot_check();
+
+ private:
+  /**
+   * @brief
+   *
+   * @param generation value of generation_ when the check started
+   * @param region_hash empty if the text is not a signed message
+   * @param result_status
+   * @param result_detail
+   */
+  void on_checked(int generation, const QByteArray& region_hash,
+                  int result_status, const QString& result_detail);
+
+  /**
+   * @brief drop the last outcome and check again
+   *
+   */
+  void recheck();
+
+  /**
+   * @brief
+   *
+   */
+  void place_label();
+
+  int channel_;
+  QPointer<QPlainTextEdit> text_edit_;
+  QPointer<QLabel> label_;
+  QTimer debounce_;
+  QByteArray region_hash_;
+  bool running_ = false;
+  bool pending_ = false;
+  int generation_ = 0;  ///< bumped by recheck(), older outcomes are dropped
+
+  static constexpr int kDebounceMs = 800;
+};
@@ -0,0 +1,92 @@
+/**
+ * Copyright (C) 2021-2026 Saturneric <eric@bktus.com>
+ *
+ * This file is part of GpgFrontend.
+ *
+ * GpgFrontend is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GpgFrontend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GpgFrontend. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The initial version of the source code is inherited from
+ * the gpg4usb project, which is under GPL-3.0-or-later.
+ *
+ * All the source code of GpgFrontend was modified and released by
+ * Saturneric <eric@bktus.com> starting on May 12, 2021.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "EMailMessageCache.h"
+
+#include "EMailHelper.h"
+#include "GFModuleCommonUtils.hpp"
+
+namespace {
+
+void ParseInto(EMailParsedMessage& parsed) {
+  parsed.message = vmime::make_shared<vmime::message>();
+  ParseEMLMessageInPlace(parsed.data, parsed.message);
+
+  ExtractEMLMetaData(parsed.message->getHeader(), parsed.meta_data);
+}
+
+}  // namespace
+
+auto ParseEMailMessage(const QByteArray& data) -> EMailParsedMessagePtr {
+  auto parsed = std::make_shared<EMailParsedMessage>();
+  parsed->data = data;
+  ParseInto(*parsed);
+  return parsed;
+}
+
+auto EMailMessageCache::GetInstance() -> EMailMessageCache& {
+  static EMailMessageCache instance;
+  return instance;
+}
+
+auto EMailMessageCache::Parse(const QByteArray& data)
+    -> EMailParsedMessagePtr {
+  if (data.size() > kMaxTotalSize) return ParseEMailMessage(data);
+
+  const auto hash = static_cast<size_t>(qHash(data));
+  {
+    QMutexLocker locker(&mutex_);
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+      if (it->hash != hash || it->parsed->data != data) continue;
+
+      entries_.splice(entries_.begin(), entries_, it);
+      return it->parsed;
+    }
+  }
+
+  auto parsed = ParseEMailMessage(data);
+
+  QMutexLocker locker(&mutex_);
+  entries_.push_front({hash, parsed});
+  total_size_ += parsed->data.size();
+  evict();
+  return parsed;
+}
+
+void EMailMessageCache::Clear() {
+  QMutexLocker locker(&mutex_);
+  entries_.clear();
+  total_size_ = 0;
+}
+
+void EMailMessageCache::evict() {
+  while (entries_.size() > kMaxEntries || total_size_ > kMaxTotalSize) {
+    total_size_ -= entries_.back().parsed->data.size();
+    entries_.pop_back();
+  }
+}
@@ -0,0 +1,111 @@
+/**
+ * Copyright (C) 2021-2026 Saturneric <eric@bktus.com>
+ *
+ * This file is part of GpgFrontend.
+ *
+ * GpgFrontend is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GpgFrontend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GpgFrontend. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The initial version of the source code is inherited from
+ * the gpg4usb project, which is under GPL-3.0-or-later.
+ *
+ * All the source code of GpgFrontend was modified and released by
+ * Saturneric <eric@bktus.com> starting on May 12, 2021.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QMutex>
+#include <list>
+#include <memory>
+
+#include "EMailModel.h"
+
+/**
+ * @brief a message parsed in place over data, together with the metadata
+ * taken from its header
+ *
+ */
+struct EMailParsedMessage {
+  QByteArray data;  ///< backs the in-place parsed body contents
+  vmime::shared_ptr<vmime::message> message;
+  EMailMetaData meta_data;  ///< from, to, cc, bcc, subject and date
+  mutable QMutex lock;      ///< parsed contents share one input stream
+};
+
+using EMailParsedMessagePtr = std::shared_ptr<const EMailParsedMessage>;
+
+/**
+ * @brief parse data in place and extract its header metadata, without caching.
+ * Throws vmime::exception on malformed input.
+ *
+ * @param data
+ * @return EMailParsedMessagePtr
+ */
+auto ParseEMailMessage(const QByteArray& data) -> EMailParsedMessagePtr;
+
+/**
+ * @brief LRU cache of parsed messages keyed by a hash of their raw data, so
+ * that repeated operations on an unchanged tab skip parsing. Entries share
+ * the caller's buffer instead of copying it. Decrypted output must not be
+ * put here, and sign and encrypt rewrite the message graph and must not use
+ * it either.
+ *
+ */
+class EMailMessageCache {
+ public:
+  /**
+   * @brief Get the Instance object
+   *
+   * @return EMailMessageCache&
+   */
+  static auto GetInstance() -> EMailMessageCache&;
+
+  /**
+   * @brief the cached message for data, parsed and inserted on a miss.
+   * Throws vmime::exception on malformed input.
+   *
+   * @param data
+   * @return EMailParsedMessagePtr
+   */
+  auto Parse(const QByteArray& data) -> EMailParsedMessagePtr;
+
+  /**
+   * @brief evict all entries
+   *
+   */
+  void Clear();
+
+ private:
+  struct Entry {
+    size_t hash;
+    EMailParsedMessagePtr parsed;
+  };
+
+  QMutex mutex_;
+  std::list<Entry> entries_;  ///< most recently used first
+  qsizetype total_size_ = 0;
+
+  static constexpr size_t kMaxEntries = 8;
+  static constexpr qsizetype kMaxTotalSize = 32 * 1024 * 1024;
+
+  /**
+   * @brief drop least recently used entries until the limits hold
+   *
+   */
+  void evict();
+};
@@ -37,6 +37,7 @@
 #include <algorithm>
 
 #include "EMailHelper.h"
+#include "EMailKeyringCache.h"
 #include "ui_EMailMetaDataDialog.h"
 
 static const QRegularExpression kNameEmailStringValidateRegex(
@@ -149,19 +150,12 @@ void EMailMetaDataDialog::slot_set_from_field_by_sign_key() {
   // only allow one sign key
   const auto sign_key = from_keys_.front();
 
-  GFGpgKeyUID* s;
-  auto ret = GFGpgKeyPrimaryUID(channel_, QDUP(sign_key), &s);
-  if (ret != 0) {
-    FLOG_WARN("cannot get primary uid from sign key %1, ret: %2", sign_key,
-              ret);
-    return;
-  }
-
-  from_name_ = UDUP(s->name);
-  from_email_ = UDUP(s->email);
-  auto comment = UDUP(s->comment);
+  const auto uids =
+      EMailKeyringCache::GetInstance().PrimaryUIDs(channel_, {sign_key});
+  if (!uids.contains(sign_key)) return;
 
-  GFFreeMemory(s);
+  from_name_ = uids[sign_key].name;
+  from_email_ = uids[sign_key].email;
 
   ui_->fromEdit->setText(QString("%1 <%2>").arg(from_name_).arg(from_email_));
 }
@@ -169,21 +163,13 @@ void EMailMetaDataDialog::slot_set_from_field_by_sign_key() {
 void EMailMetaDataDialog::slot_set_to_field_by_encrypt_keys() {
   QStringList to_list;
 
+  const auto uids =
+      EMailKeyringCache::GetInstance().PrimaryUIDs(channel_, to_keys_);
   for (const auto& key : to_keys_) {
-    GFGpgKeyUID* s;
-    auto ret = GFGpgKeyPrimaryUID(channel_, QDUP(key), &s);
-    if (ret != 0) {
-      FLOG_WARN("cannot get primary uid from sign key %1, ret: %2", key, ret);
-      continue;
-    }
-
-    from_name_ = UDUP(s->name);
-    from_email_ = UDUP(s->email);
-    auto comment = UDUP(s->comment);
-
-    GFFreeMemory(s);
+    auto it = uids.constFind(key);
+    if (it == uids.constEnd()) continue;
 
-    to_list.append(QString("%1 <%2>").arg(from_name_).arg(from_email_));
+    to_list.append(QString("%1 <%2>").arg(it->name).arg(it->email));
   }
 
   ui_->toEdit->setText(to_list.join("; "));
@@ -50,9 +50,10 @@ struct EMailMetaData {
   QString micalg;
 
   // OpenPGP MetaData
-  QString public_keys;
+  QByteArray public_keys;
   QByteArray mime;
   QString mime_hash;
+  QString signer_fpr;  ///< set by a verify with exactly one signature
   QByteArray signature;
   QByteArray encrypted_data;
 };
\ No newline at end of file
@@ -44,9 +44,13 @@
 #include <QMainWindow>
 #include <QMenu>
 #include <QMessageBox>
+#include <QMutex>
 #include <QPlainTextEdit>
+#include <QSaveFile>
 #include <QString>
+#include <QTextBlock>
 #include <QTextDocument>
+#include <QThreadPool>
 
 #include "EMailMetaDataDialog.h"
 
@@ -62,8 +66,17 @@
 #include "GFModuleDefine.h"
 
 //
+#include "EMailBase64.h"
 #include "EMailBasicGpgOpera.h"
+#include "EMailBatchOpera.h"
+#include "EMailFileLoader.h"
+#include "EMailGpgChannel.h"
 #include "EMailHelper.h"
+#include "EMailKeyringCache.h"
+#include "EMailLiveVerifier.h"
+#include "EMailMessageCache.h"
+#include "EMailPGPMIMEScanner.h"
+#include "EMailVerifyIndex.h"
 
 GF_MODULE_API_DEFINE_V2("com.bktus.gpgfrontend.module.email", "Email", "1.2.3",
                         "Everything related to E-Mails.", "Saturneric")
@@ -72,6 +85,78 @@ DEFINE_TRANSLATIONS_STRUCTURE(ModuleEMail);
 
 namespace {
 
+// Cancellation flags of the running batch and async operations, keyed by the
+// trigger id of the event that started them.
+QMutex op_cancel_flags_mutex;
+QMap<QString, EMailBatchCancelFlag> op_cancel_flags;
+
+// flag of the async operation running on this pool thread, if any
+thread_local EMailBatchCancelFlag current_op_cancel_flag;
+
+// a new cancellation flag under op_id, or nullptr if op_id is taken
+auto RegisterOpCancelFlag(const QString& op_id) -> EMailBatchCancelFlag {
+  QMutexLocker locker(&op_cancel_flags_mutex);
+  if (op_cancel_flags.contains(op_id)) return nullptr;
+
+  auto cancel_flag = std::make_shared<std::atomic_bool>(false);
+  op_cancel_flags.insert(op_id, cancel_flag);
+  return cancel_flag;
+}
+
+// Checked between the parse and the GnuPG stage of an operation; GnuPG
+// itself is not interrupted once started.
+auto EMailOpCheckpoint(QString& error_string) -> bool {
+  if (current_op_cancel_flag == nullptr || !current_op_cancel_flag->load()) {
+    return true;
+  }
+  error_string = "Operation cancelled";
+  return false;
+}
+
+void UpsertOpProgress(const QString& op_id, const QString& state) {
+  GFModuleUpsertRTValue(GFGetModuleID(),
+                        QDUP(QString("email.op.%1.progress").arg(op_id)),
+                        QDUP(state));
+}
+
+// With "async" set to "true" the event returns at once and the handler runs
+// on the thread pool, delivering its CB when done. The runtime value
+// "email.op.<trigger_id>.progress" moves through queued, running and done or
+// cancelled; EMAIL_OP_CANCEL stops the operation at its next checkpoint.
+// The trigger id keys both, so it must be set and not already running.
+auto AsyncEMailOp(EventHandler handler) -> EventHandler {
+  return [handler](const MEvent& event) -> int {
+    if (event["async"] != "true") return handler(event);
+
+    const auto op_id = event["trigger_id"];
+    if (op_id.isEmpty()) CB_ERR(event, -1, "trigger_id is empty");
+
+    auto cancel_flag = RegisterOpCancelFlag(op_id);
+    if (cancel_flag == nullptr) {
+      CB_ERR(event, -1, "trigger_id is already running");
+    }
+    UpsertOpProgress(op_id, "queued");
+
+    QThreadPool::globalInstance()->start([=]() {
+      if (cancel_flag->load()) {
+        CB_ERR_NO_RET(event, -1, "operation cancelled");
+      } else {
+        UpsertOpProgress(op_id, "running");
+        current_op_cancel_flag = cancel_flag;
+        handler(event);
+        current_op_cancel_flag = nullptr;
+      }
+
+      {
+        QMutexLocker locker(&op_cancel_flags_mutex);
+        op_cancel_flags.remove(op_id);
+      }
+      UpsertOpProgress(op_id, cancel_flag->load() ? "cancelled" : "done");
+    });
+    return 0;
+  };
+}
+
 // Build one Info Board card object (title/status/fields) in the JSON shape the
 // UI's decode_info_board_cards() expects. Empty values are dropped so the card
 // stays compact, matching how the native operations render.
@@ -117,19 +202,19 @@ auto BuildOpenPGPMetaCard(const EMailMetaData& m) -> QJsonObject {
 // recipient card.
 auto BuildRecipientCards(int channel, const QStringList& encrypt_keys)
     -> QJsonArray {
+  const auto uids =
+      EMailKeyringCache::GetInstance().PrimaryUIDs(channel, encrypt_keys);
+
   QJsonArray cards;
   for (const auto& key_id : encrypt_keys) {
     if (key_id.isEmpty()) continue;
 
     QString recipient;
-    GFGpgKeyUID* uid = nullptr;
-    if (GFGpgKeyPrimaryUID(channel, QDUP(key_id), &uid) == 0 &&
-        uid != nullptr) {
-      const auto name = UDUP(uid->name);
-      const auto email = UDUP(uid->email);
-      UDUP(uid->comment);  // free the unused field
-      GFFreeMemory(uid);
-      recipient = email.isEmpty() ? name : QString("%1 <%2>").arg(name, email);
+    auto it = uids.constFind(key_id);
+    if (it != uids.constEnd()) {
+      recipient = it->email.isEmpty()
+                      ? it->name
+                      : QString("%1 <%2>").arg(it->name, it->email);
     }
 
     cards.append(MakeCardJson(
@@ -140,19 +225,31 @@ auto BuildRecipientCards(int channel, const QStringList& encrypt_keys)
   return cards;
 }
 
+// The elements of a JSON array text without the surrounding brackets, so card
+// arrays can be spliced together without a parse and re-serialize round trip.
+// Anything that is not an array yields nothing.
+auto ArrayElements(const QString& json_array) -> QStringView {
+  auto view = QStringView(json_array).trimmed();
+  if (view.size() < 2 || view.front() != '[' || view.back() != ']') return {};
+  return view.mid(1, view.size() - 2).trimmed();
+}
+
+void AppendArrayElements(QString& out, QStringView elements) {
+  if (elements.isEmpty()) return;
+  if (!out.endsWith('[')) out += ',';
+  out.append(elements.data(), static_cast<int>(elements.size()));
+}
+
 // Concatenate two crypto card JSON arrays (as returned by GFAnalyse*Result)
 // into one, for combined operations like Encrypt+Sign and Decrypt+Verify.
 auto MergeCardArrays(const QString& a, const QString& b) -> QString {
-  QJsonArray merged;
-  for (const auto& s : {a, b}) {
-    if (s.isEmpty()) continue;
-    const auto doc = QJsonDocument::fromJson(s.toUtf8());
-    if (doc.isArray()) {
-      for (const auto& v : doc.array()) merged.append(v);
-    }
-  }
-  return QString::fromUtf8(
-      QJsonDocument(merged).toJson(QJsonDocument::Compact));
+  QString merged;
+  merged.reserve(a.size() + b.size() + 1);
+  merged += '[';
+  AppendArrayElements(merged, ArrayElements(a));
+  AppendArrayElements(merged, ArrayElements(b));
+  merged += ']';
+  return merged;
 }
 
 // Assemble the `result_cards` payload the UI decodes: the module's own metadata
@@ -162,18 +259,109 @@ auto MergeCardArrays(const QString& a, const QString& b) -> QString {
 auto BuildResultCardsParam(const QString& operation,
                            const QJsonArray& meta_cards,
                            const QString& crypto_cards_json) -> QString {
-  QJsonArray cards = meta_cards;
-  if (!crypto_cards_json.isEmpty()) {
-    const auto doc = QJsonDocument::fromJson(crypto_cards_json.toUtf8());
-    if (doc.isArray()) {
-      for (const auto& v : doc.array()) cards.append(v);
-    }
+  const auto crypto_cards = ArrayElements(crypto_cards_json);
+  if (meta_cards.isEmpty() && crypto_cards.isEmpty()) return {};
+
+  // only the module's own cards and the operation name go through QJson, the
+  // SDK's cards are copied over as they are
+  const auto meta_cards_json = QString::fromUtf8(
+      QJsonDocument(meta_cards).toJson(QJsonDocument::Compact));
+  const auto operation_json = QString::fromUtf8(
+      QJsonDocument(QJsonArray{operation}).toJson(QJsonDocument::Compact));
+
+  QString param;
+  param.reserve(meta_cards_json.size() + crypto_cards.size() +
+                operation_json.size() + 32);
+  const auto operation_string = ArrayElements(operation_json);
+  param += QLatin1String(R"({"operation":)");
+  param.append(operation_string.data(),
+               static_cast<int>(operation_string.size()));
+  param += QLatin1String(R"(,"cards":[)");
+  AppendArrayElements(param, ArrayElements(meta_cards_json));
+  AppendArrayElements(param, crypto_cards);
+  param += QLatin1String("]}");
+  return param;
+}
+
+void AppendMarkdownField(QString& out, const QString& label,
+                         const QString& value) {
+  out += QLatin1String("- ");
+  out += label;
+  out += QLatin1String(": ");
+  out += value;
+  out += '\n';
+}
+
+// Markdown report of the verify and decrypt handlers, written into a single
+// preallocated buffer. The signed entity hash and micalg only exist for
+// verified messages.
+auto BuildEMailInfo(const EMailMetaData& m, const QString& result_detail,
+                    bool with_signed_entity) -> QString {
+  QString info;
+  info.reserve(1024 + result_detail.size());
+
+  info += QLatin1String("# E-Mail Information\n\n");
+  AppendMarkdownField(info, QApplication::translate("EMailModule", "From"),
+                      m.from);
+  AppendMarkdownField(info, QApplication::translate("EMailModule", "To"),
+                      m.to.join("; "));
+  AppendMarkdownField(info, QApplication::translate("EMailModule", "Subject"),
+                      m.subject);
+  AppendMarkdownField(info, QApplication::translate("EMailModule", "CC"),
+                      m.cc.join("; "));
+  AppendMarkdownField(info, QApplication::translate("EMailModule", "BCC"),
+                      m.bcc.join("; "));
+  AppendMarkdownField(info, QApplication::translate("EMailModule", "Date"),
+                      QLocale().toString(m.datetime));
+  info += '\n';
+
+  info += QLatin1String("# OpenPGP Information\n\n");
+  if (with_signed_entity) {
+    AppendMarkdownField(
+        info,
+        QApplication::translate("EMailModule", "Signed EML Data Hash (SHA1)"),
+        m.mime_hash);
+    AppendMarkdownField(
+        info,
+        QApplication::translate("EMailModule",
+                                "Message Integrity Check Algorithm"),
+        m.micalg);
+    info += '\n';
   }
 
-  if (cards.isEmpty()) return {};
+  info += '#';
+  info += result_detail;
+  info += '\n';
+  return info;
+}
 
-  QJsonObject obj{{"operation", operation}, {"cards", cards}};
-  return QString::fromUtf8(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+// Tab content is parsed once and reused by the following operations for as
+// long as it stays unchanged.
+auto ParseCachedEMLMessage(const QByteArray& data, QString& error_string)
+    -> EMailParsedMessagePtr {
+  try {
+    auto parsed = EMailMessageCache::GetInstance().Parse(data);
+    return EMailOpCheckpoint(error_string) ? parsed : nullptr;
+  } catch (const vmime::exception& e) {
+    FLOG_DEBUG("error when parsing vmime data: %1", e.what());
+    error_string = "Error when parsing eml raw data";
+    return nullptr;
+  }
+}
+
+// Payloads arrive as base64 text in the `<key>` param, event params are
+// plain strings.
+auto HasEventPayload(const MEvent& event, const QString& key) -> bool {
+  return !event.value(key).isEmpty();
+}
+
+auto ReadEventPayload(const MEvent& event, const QString& key) -> QByteArray {
+  return Base64Decode(event.value(key).toLatin1());
+}
+
+// reply to the event as this module
+void PayloadCB(const MEvent& event, const QMap<QString, QString>& params) {
+  CB(event, GFGetModuleID(), params);
 }
 
 }  // namespace
@@ -193,6 +381,14 @@ auto GFRegisterModule() -> int {
   LISTEN("EDIT_TAB_TYPE_EMAIL_OP_DECRYPT_VERIFY");
 
   LISTEN("EDIT_TAB_TYPE_EMAIL_OP_SAVE_FILE");
+  LISTEN("EDIT_TAB_TYPE_EMAIL_OP_IMPORT_KEYS");
+
+  LISTEN("EMAIL_OP_ENCRYPT_PER_RECIPIENT");
+  LISTEN("EMAIL_OP_BATCH_VERIFY_DECRYPT");
+  LISTEN("EMAIL_OP_BATCH_CANCEL");
+  LISTEN("EMAIL_OP_CANCEL");
+
+  LISTEN("KEY_DATABASE_REFRESHED");
 
   // register file extension handler
   GFUIRegisterFileExtensionHandleEvent(DUP("eml"), DUP("EMAIL"));
@@ -208,6 +404,10 @@ auto GFDeactivateModule() -> int { return 0; }
 auto GFUnregisterModule() -> int {
   MLogDebug("email module unregistering...");
 
+  EMailMessageCache::GetInstance().Clear();
+  EMailKeyringCache::GetInstance().Invalidate();
+  EMailVerifyIndex::GetInstance().Save();
+
   return 0;
 }
 
@@ -269,6 +469,31 @@ auto ErrorHelper(int ret, const QString& err) -> QString {
   return error_message;
 }
 
+/**
+ * @brief re-verify the text of an email tab in the background while it is
+ * edited, must be called from the GUI thread
+ *
+ * @param page
+ * @param channel the channel the tab's operations run on, the current GPG
+ * context when the event that opened the tab did not carry one
+ */
+void AttachLiveVerifier(QWidget* page, int channel) {
+  if (channel < 0) {
+    LOG_WARN("no gpg context available, live verification disabled");
+    return;
+  }
+
+  QPlainTextEdit* text_edit = nullptr;
+  auto ok = QMetaObject::invokeMethod(page, "GetTextPage", Qt::DirectConnection,
+                                      Q_RETURN_ARG(QPlainTextEdit*, text_edit));
+  if (!ok || text_edit == nullptr) {
+    LOG_WARN("invoke GetTextPage failed, live verification disabled");
+    return;
+  }
+
+  new EMailLiveVerifier(channel, text_edit, page);
+}
+
 }  // namespace
 
 REGISTER_EVENT_HANDLER(MAINWINDOW_MENU_MOUNTED, [](const MEvent& event) -> int {
@@ -324,11 +549,16 @@ REGISTER_EVENT_HANDLER(MAINWINDOW_MENU_MOUNTED, [](const MEvent& event) -> int {
         action->setIcon(QIcon(":/icons/email.png"));
         bool ok =
             QObject::connect(action, &QAction::triggered, parent, [edit]() {
-              QMetaObject::invokeMethod(
+              QWidget* page = nullptr;
+              auto ok = QMetaObject::invokeMethod(
                   edit, "SlotNewCustomTab", Qt::DirectConnection,
-                  Q_ARG(QString, "email"), Q_ARG(QString, "untitled.eml"),
+                  Q_RETURN_ARG(QWidget*, page), Q_ARG(QString, "email"),
+                  Q_ARG(QString, "untitled.eml"),
                   Q_ARG(QIcon, QIcon(":/icons/email.png")),
                   Q_ARG(QString, ":/icons/email.png"));
+              if (ok && page != nullptr) {
+                AttachLiveVerifier(page, GFGpgCurrentGpgContextChannel());
+              }
             });
 
         if (!ok) {
@@ -343,62 +573,119 @@ REGISTER_EVENT_HANDLER(MAINWINDOW_MENU_MOUNTED, [](const MEvent& event) -> int {
 
 namespace {
 
-auto DoVerifyEMLData(int channel, const QByteArray& data, const MEvent& event,
-                     int& result_status, QString& result_detail,
-                     QString& result_cards, QString& error_string,
-                     EMailMetaData& meta_data) -> int {
+auto DoVerifyEMLMessage(int channel, const EMailParsedMessagePtr& parsed,
+                        const MEvent& event, int& result_status,
+                        QString& result_detail, QString& result_cards,
+                        QString& error_string, EMailMetaData& meta_data)
+    -> int {
   gpg_error_t err;
   QString capsule_id;
-  auto ret =
-      VerifyEMLData(channel, data, meta_data, error_string, err, capsule_id);
+  auto ret = parsed != nullptr
+                 ? VerifyEMLMessage(channel, *parsed, meta_data, error_string,
+                                    err, capsule_id)
+                 : kEML_FAILED;
   if (ret == kFAILED || ret == kEML_FAILED) {
-    CB(event, GFGetModuleID(),
-       {
-           {"ret", QString::number(0)},
-           {"result_status", QString::number(-1)},
-           {"result", ErrorHelper(ret, error_string)},
-       });
+    PayloadCB(event,
+              {
+                  {"ret", QString::number(0)},
+                  {"result_status", QString::number(-1)},
+                  {"result", ErrorHelper(ret, error_string)},
+              });
     return ret;
   }
 
   const char* tmp = nullptr;
   const char* cards_tmp = nullptr;
-  result_status = GFAnalyseVerifyResultByCapsule(channel, err, QDUP(capsule_id),
-                                                 &tmp, &cards_tmp);
+  result_status = WithGpgChannel(channel, [&]() {
+    return GFAnalyseVerifyResultByCapsule(channel, err, QDUP(capsule_id), &tmp,
+                                          &cards_tmp);
+  });
   result_detail = UnStrDup(tmp);
   result_cards = UnStrDup(cards_tmp);
 
   if (ret == kGPG_FAILED) {
     // decrypt failed
-    CB(event, GFGetModuleID(),
-       {
-           {"ret", QString::number(0)},
-           {"result_status", QString::number(result_status)},
-           {"result", result_detail},
-       });
+    PayloadCB(event,
+              {
+                  {"ret", QString::number(0)},
+                  {"result_status", QString::number(result_status)},
+                  {"result", result_detail},
+              });
     return ret;
   }
 
   if (ret != kSUCCESS) {
-    CB(event, GFGetModuleID(),
-       {
-           {"ret", QString::number(0)},
-           {"result_status", QString::number(-1)},
-           {"result", ErrorHelper(ret, error_string)},
-       });
+    PayloadCB(event,
+              {
+                  {"ret", QString::number(0)},
+                  {"result_status", QString::number(-1)},
+                  {"result", ErrorHelper(ret, error_string)},
+              });
     return ret;
   }
   return kSUCCESS;
 }
+
+auto DoVerifyEMLData(int channel, const QByteArray& data, const MEvent& event,
+                     int& result_status, QString& result_detail,
+                     QString& result_cards, QString& error_string,
+                     EMailMetaData& meta_data) -> int {
+  // malformed input is turned away before it reaches the index or the parser
+  EMailPGPMIMEStructure structure;
+  const auto scanned = ScanPGPMIMEStructure(data, EMailPGPMIMEType::kSigned,
+                                            structure, error_string);
+
+  // a message verified before under the same keyring only needs its header
+  auto& index = EMailVerifyIndex::GetInstance();
+  const auto key =
+      scanned ? EMailVerifyIndex::Key(channel, data, structure) : QString{};
+  EMailVerifyIndexEntry entry;
+  vmime::shared_ptr<vmime::message> header_only;
+  if (scanned && index.Lookup(key, entry) &&
+      CheckIfEMLMessage(data, header_only)) {
+    FLOG_DEBUG("verify outcome taken from index, signer: %1", entry.signer_fpr);
+    GetEMLMetaData(header_only, meta_data);
+    meta_data.micalg = entry.micalg;
+    meta_data.mime_hash = entry.mime_hash;
+    result_status = entry.result_status;
+    result_detail = entry.result_detail;
+    result_cards = entry.result_cards;
+    if (entry.verified) return kSUCCESS;
+
+    PayloadCB(event,
+              {
+                  {"ret", QString::number(0)},
+                  {"result_status", QString::number(result_status)},
+                  {"result", result_detail},
+              });
+    return kGPG_FAILED;
+  }
+
+  auto parsed = scanned ? ParseCachedEMLMessage(data, error_string) : nullptr;
+  auto ret = DoVerifyEMLMessage(channel, parsed, event, result_status,
+                                result_detail, result_cards, error_string,
+                                meta_data);
+  if (scanned && (ret == kSUCCESS || ret == kGPG_FAILED)) {
+    entry.result_status = result_status;
+    entry.verified = ret == kSUCCESS;
+    entry.result_detail = result_detail;
+    entry.result_cards = result_cards;
+    entry.signer_fpr = meta_data.signer_fpr;
+    entry.micalg = meta_data.micalg;
+    entry.mime_hash = meta_data.mime_hash;
+    index.Record(key, entry);
+  }
+  return ret;
+}
 }  // namespace
 
 REGISTER_EVENT_HANDLER(
     EDIT_TAB_TYPE_EMAIL_OP_VERIFY, [](const MEvent& event) -> int {
       if (event["channel"].isEmpty()) CB_ERR(event, -1, "channel is empty");
-      if (event["data"].isEmpty()) CB_ERR(event, -1, "data is empty");
+      if (!HasEventPayload(event, "data")) CB_ERR(event, -1, "data is empty");
 
       auto channel = event.value("channel", "0").toInt();
-      auto data = QByteArray::fromBase64(QString(event["data"]).toLatin1());
+      auto data = ReadEventPayload(event, "data");
 
       EMailMetaData meta_data;
       QString error_string;
@@ -410,45 +697,7 @@ REGISTER_EVENT_HANDLER(
         return -1;
       }
 
-      QString email_info;
-      email_info.append("# E-Mail Information\n\n");
-      email_info.append(QString("- %1: %2\n")
-                            .arg(QApplication::translate("EMailModule", "From"))
-                            .arg(meta_data.from));
-      email_info.append(QString("- %1: %2\n")
-                            .arg(QApplication::translate("EMailModule", "To"))
-                            .arg(meta_data.to.join("; ")));
-      email_info.append(
-          QString("- %1: %2\n")
-              .arg(QApplication::translate("EMailModule", "Subject"))
-              .arg(meta_data.subject));
-      email_info.append(QString("- %1: %2\n")
-                            .arg(QApplication::translate("EMailModule", "CC"))
-                            .arg(meta_data.cc.join("; ")));
-      email_info.append(QString("- %1: %2\n")
-                            .arg(QApplication::translate("EMailModule", "BCC"))
-                            .arg(meta_data.bcc.join("; ")));
-      email_info.append(QString("- %1: %2\n")
-                            .arg(QApplication::translate("EMailModule", "Date"))
-                            .arg(QLocale().toString(meta_data.datetime)));
-
-      email_info.append("\n");
-
-      email_info.append("# OpenPGP Information\n\n");
-
-      email_info.append(QString("- %1: %2\n")
-                            .arg(QApplication::translate(
-                                "EMailModule", "Signed EML Data Hash (SHA1)"))
-                            .arg(meta_data.mime_hash));
-      email_info.append(
-          QString("- %1: %2\n")
-              .arg(QApplication::translate("EMailModule",
-                                           "Message Integrity Check Algorithm"))
-              .arg(meta_data.micalg));
-
-      email_info.append("\n");
-
-      email_info.append("#" + result_detail + "\n");
+      const auto email_info = BuildEMailInfo(meta_data, result_detail, true);
 
       const auto result_cards_param = BuildResultCardsParam(
           QApplication::translate("EMailModule", "Verify E-Mail"),
@@ -456,13 +705,13 @@ REGISTER_EVENT_HANDLER(
           result_cards);
 
       // callback
-      CB(event, GFGetModuleID(),
-         {
-             {"ret", QString::number(0)},
-             {"result_status", QString::number(result_status)},
-             {"result", email_info},
-             {"result_cards", result_cards_param},
-         });
+      PayloadCB(event,
+                {
+                    {"ret", QString::number(0)},
+                    {"result_status", QString::number(result_status)},
+                    {"result", email_info},
+                    {"result_cards", result_cards_param},
+                });
       return 0;
     });
 
@@ -474,47 +723,56 @@ auto DoDecryptEMLData(int channel, const QByteArray& data, const MEvent& event,
                       EMailMetaData& meta_data) -> int {
   gpgme_error_t err;
   QString capsule_id;
-  auto ret =
-      DecryptEMLData(channel, data, meta_data, eml_data, err, capsule_id);
+  EMailPGPMIMEStructure structure;
+  auto parsed = ScanPGPMIMEStructure(data, EMailPGPMIMEType::kEncrypted,
+                                     structure, eml_data)
+                    ? ParseCachedEMLMessage(data, eml_data)
+                    : nullptr;
+  auto ret = parsed != nullptr
+                 ? DecryptEMLMessage(channel, *parsed, meta_data, eml_data,
+                                     err, capsule_id)
+                 : kEML_FAILED;
 
   if (ret == kFAILED || ret == kEML_FAILED) {
-    CB(event, GFGetModuleID(),
-       {
-           {"ret", QString::number(0)},
-           {"data", data},
-           {"result_status", QString::number(-1)},
-           {"result", ErrorHelper(ret, eml_data)},
-       });
+    PayloadCB(event,
+              {
+                  {"ret", QString::number(0)},
+                  {"data", data},
+                  {"result_status", QString::number(-1)},
+                  {"result", ErrorHelper(ret, eml_data)},
+              });
     return ret;
   }
 
   const char* tmp = nullptr;
   const char* cards_tmp = nullptr;
-  result_status = GFAnalyseDecryptResultByCapsule(
-      channel, err, QDUP(capsule_id), &tmp, &cards_tmp);
+  result_status = WithGpgChannel(channel, [&]() {
+    return GFAnalyseDecryptResultByCapsule(channel, err, QDUP(capsule_id), &tmp,
+                                           &cards_tmp);
+  });
   result_detail = UnStrDup(tmp);
   result_cards = UnStrDup(cards_tmp);
 
   if (ret == kGPG_FAILED) {
     // decrypt failed
-    CB(event, GFGetModuleID(),
-       {
-           {"ret", QString::number(0)},
-           {"data", data},
-           {"result_status", QString::number(result_status)},
-           {"result", result_detail},
-       });
+    PayloadCB(event,
+              {
+                  {"ret", QString::number(0)},
+                  {"data", data},
+                  {"result_status", QString::number(result_status)},
+                  {"result", result_detail},
+              });
     return ret;
   }
 
   if (ret != kSUCCESS) {
-    CB(event, GFGetModuleID(),
-       {
-           {"ret", QString::number(0)},
-           {"data", data},
-           {"result_status", QString::number(-1)},
-           {"result", ErrorHelper(ret, eml_data)},
-       });
+    PayloadCB(event,
+              {
+                  {"ret", QString::number(0)},
+                  {"data", data},
+                  {"result_status", QString::number(-1)},
+                  {"result", ErrorHelper(ret, eml_data)},
+              });
     return ret;
   }
 
@@ -526,10 +784,10 @@ auto DoDecryptEMLData(int channel, const QByteArray& data, const MEvent& event,
 REGISTER_EVENT_HANDLER(
     EDIT_TAB_TYPE_EMAIL_OP_DECRYPT, [](const MEvent& event) -> int {
       if (event["channel"].isEmpty()) CB_ERR(event, -1, "channel is empty");
-      if (event["data"].isEmpty()) CB_ERR(event, -1, "data is empty");
+      if (!HasEventPayload(event, "data")) CB_ERR(event, -1, "data is empty");
 
       auto channel = event.value("channel", "0").toInt();
-      auto data = QByteArray::fromBase64(QString(event["data"]).toLatin1());
+      auto data = ReadEventPayload(event, "data");
 
       QString eml_data;
       int result_status;
@@ -541,111 +799,103 @@ REGISTER_EVENT_HANDLER(
         return -1;
       }
 
-      QString email_info;
-      email_info.append("# E-Mail Information\n\n");
-      email_info.append(QString("- %1: %2\n")
-                            .arg(QApplication::translate("EMailModule", "From"))
-                            .arg(meta_data.from));
-      email_info.append(QString("- %1: %2\n")
-                            .arg(QApplication::translate("EMailModule", "To"))
-                            .arg(meta_data.to.join("; ")));
-      email_info.append(
-          QString("- %1: %2\n")
-              .arg(QApplication::translate("EMailModule", "Subject"))
-              .arg(meta_data.subject));
-      email_info.append(QString("- %1: %2\n")
-                            .arg(QApplication::translate("EMailModule", "CC"))
-                            .arg(meta_data.cc.join("; ")));
-      email_info.append(QString("- %1: %2\n")
-                            .arg(QApplication::translate("EMailModule", "BCC"))
-                            .arg(meta_data.bcc.join("; ")));
-      email_info.append(QString("- %1: %2\n")
-                            .arg(QApplication::translate("EMailModule", "Date"))
-                            .arg(QLocale().toString(meta_data.datetime)));
-
-      email_info.append("\n");
-
-      email_info.append("# OpenPGP Information\n\n");
-      email_info.append("#" + result_detail + "\n");
+      const auto email_info = BuildEMailInfo(meta_data, result_detail, false);
 
       const auto result_cards_param = BuildResultCardsParam(
           QApplication::translate("EMailModule", "Decrypt E-Mail"),
           {BuildEMailHeaderCard(meta_data)}, result_cards);
 
       // callback
-      CB(event, GFGetModuleID(),
-         {
-             {"ret", QString::number(0)},
-             {"data", eml_data},
-             {"result_status", QString::number(result_status)},
-             {"result", email_info},
-             {"result_cards", result_cards_param},
-         });
+      PayloadCB(event,
+                {
+                    {"ret", QString::number(0)},
+                    {"data", eml_data},
+                    {"result_status", QString::number(result_status)},
+                    {"result", email_info},
+                    {"result_cards", result_cards_param},
+                });
       return kSUCCESS;
     });
 
 namespace {
 
-auto DoSignEMLData(int channel, const QString& sign_key,
-                   vmime::shared_ptr<vmime::message>& message,
-                   const QByteArray& body_data, const MEvent& event,
-                   int& result_status, QString& result_detail,
-                   QString& result_cards, QString& eml_data) -> int {
-  EMailMetaData meta_data;
-  auto ret = GetEMLMetaData(message, meta_data);
-
-  if (ret != 0) {
-    CB_ERR(event, -1, "Get MetaData From EML Data Failed");
-  }
-
-  gpg_error_t err;
-  QString capsule_id;
-  ret = SignEMLData(channel, sign_key, message, eml_data, err, capsule_id);
-
+// Report a failed sign step to the caller and analyse the capsule of a
+// finished one. Shared by the plain sign operations and the sign step of the
+// combined Encrypt+Sign operation.
+auto HandleSignResult(int channel, int ret, gpgme_error_t err,
+                      const QString& capsule_id, const QString& error_string,
+                      const QByteArray& body_data, const MEvent& event,
+                      int& result_status, QString& result_detail,
+                      QString& result_cards) -> int {
   if (ret == kFAILED || ret == kEML_FAILED) {
-    CB(event, GFGetModuleID(),
-       {
-           {"ret", QString::number(0)},
-           {"data", body_data},
-           {"result_status", QString::number(-1)},
-           {"result", ErrorHelper(ret, eml_data)},
-       });
+    PayloadCB(event,
+              {
+                  {"ret", QString::number(0)},
+                  {"data", body_data},
+                  {"result_status", QString::number(-1)},
+                  {"result", ErrorHelper(ret, error_string)},
+              });
     return ret;
   }
 
   const char* tmp = nullptr;
   const char* cards_tmp = nullptr;
-  result_status = GFAnalyseSignResultByCapsule(channel, err, QDUP(capsule_id),
-                                               &tmp, &cards_tmp);
+  result_status = WithGpgChannel(channel, [&]() {
+    return GFAnalyseSignResultByCapsule(channel, err, QDUP(capsule_id), &tmp,
+                                        &cards_tmp);
+  });
   result_detail = UnStrDup(tmp);
   result_cards = UnStrDup(cards_tmp);
 
   if (ret == kGPG_FAILED) {
-    // decrypt failed
-    CB(event, GFGetModuleID(),
-       {
-           {"ret", QString::number(0)},
-           {"data", body_data},
-           {"result_status", QString::number(result_status)},
-           {"result", result_detail},
-       });
+    // sign failed
+    PayloadCB(event,
+              {
+                  {"ret", QString::number(0)},
+                  {"data", body_data},
+                  {"result_status", QString::number(result_status)},
+                  {"result", result_detail},
+              });
     return ret;
   }
 
   if (ret != kSUCCESS) {
-    CB(event, GFGetModuleID(),
-       {
-           {"ret", QString::number(0)},
-           {"data", body_data},
-           {"result_status", QString::number(-1)},
-           {"result", ErrorHelper(ret, eml_data)},
-       });
+    PayloadCB(event,
+              {
+                  {"ret", QString::number(0)},
+                  {"data", body_data},
+                  {"result_status", QString::number(-1)},
+                  {"result", ErrorHelper(ret, error_string)},
+              });
     return ret;
   }
 
   return kSUCCESS;
 }
 
+auto DoSignEMLData(int channel, const QString& sign_key,
+                   vmime::shared_ptr<vmime::message>& message,
+                   const QByteArray& body_data, const MEvent& event,
+                   int& result_status, QString& result_detail,
+                   QString& result_cards, QString& eml_data) -> int {
+  EMailMetaData meta_data;
+  auto ret = GetEMLMetaData(message, meta_data);
+
+  if (ret != 0) {
+    CB_ERR(event, -1, "Get MetaData From EML Data Failed");
+  }
+
+  gpg_error_t err;
+  QString capsule_id;
+  ret = EMailOpCheckpoint(eml_data) &&
+                ParseEMLBody(body_data, message, eml_data)
+            ? SignEMLData(channel, sign_key, message, eml_data, err, capsule_id)
+            : kEML_FAILED;
+
+  return HandleSignResult(channel, ret, err, capsule_id, eml_data, body_data,
+                          event, result_status, result_detail, result_cards);
+}
+
 auto DoSignPlainText(int channel, const QString& sign_key,
                      const EMailMetaData& meta_data,
                      const QByteArray& body_data, const MEvent& event,
@@ -656,55 +906,17 @@ auto DoSignPlainText(int channel, const QString& sign_key,
 
   auto ret = SignPlainText(channel, sign_key, meta_data, body_data, eml_data,
                            err, capsule_id);
-  if (ret == kFAILED || ret == kEML_FAILED) {
-    CB(event, GFGetModuleID(),
-       {
-           {"ret", QString::number(0)},
-           {"data", body_data},
-           {"result_status", QString::number(-1)},
-           {"result", ErrorHelper(ret, eml_data)},
-       });
-    return ret;
-  }
-
-  const char* tmp = nullptr;
-  const char* cards_tmp = nullptr;
-  result_status = GFAnalyseSignResultByCapsule(channel, err, QDUP(capsule_id),
-                                               &tmp, &cards_tmp);
-  result_detail = UnStrDup(tmp);
-  result_cards = UnStrDup(cards_tmp);
 
-  if (ret == kGPG_FAILED) {
-    // decrypt failed
-    CB(event, GFGetModuleID(),
-       {
-           {"ret", QString::number(0)},
-           {"data", body_data},
-           {"result_status", QString::number(result_status)},
-           {"result", result_detail},
-       });
-    return ret;
-  }
-
-  if (ret != kSUCCESS) {
-    CB(event, GFGetModuleID(),
-       {
-           {"ret", QString::number(0)},
-           {"data", body_data},
-           {"result_status", QString::number(-1)},
-           {"result", ErrorHelper(ret, eml_data)},
-       });
-    return ret;
-  }
-
-  return kSUCCESS;
+  return HandleSignResult(channel, ret, err, capsule_id, eml_data, body_data,
+                          event, result_status, result_detail, result_cards);
 }
 
 }  // namespace
 
 REGISTER_EVENT_HANDLER(
     EDIT_TAB_TYPE_EMAIL_OP_SIGN, [](const MEvent& event) -> int {
-      if (event["body_data"].isEmpty()) CB_ERR(event, -1, "body_data is empty");
+      if (!HasEventPayload(event, "body_data"))
+        CB_ERR(event, -1, "body_data is empty");
       if (event["channel"].isEmpty()) CB_ERR(event, -1, "channel is empty");
       if (event["sign_key"].isEmpty()) CB_ERR(event, -1, "sign_key is empty");
 
@@ -713,8 +925,7 @@ REGISTER_EVENT_HANDLER(
 
       FLOG_DEBUG("eml sign key: %1", sign_key);
 
-      auto body_data =
-          QByteArray::fromBase64(QString(event["body_data"]).toLatin1());
+      auto body_data = ReadEventPayload(event, "body_data");
 
       auto* dialog = GUI_OBJECT(CreateEMailMetaDataDialog, {});
       auto* r_dialog =
@@ -738,17 +949,18 @@ REGISTER_EVENT_HANDLER(
           return -1;
         }
 
-        CB(event, GFGetModuleID(),
-           {
-               {"ret", QString::number(0)},
-               {"data", eml_data},
-               {"result_status", QString::number(result_status)},
-               {"result", result_detail},
-               {"result_cards",
-                BuildResultCardsParam(
-                    QApplication::translate("EMailModule", "Sign E-Mail"), {},
-                    result_cards)},
-           });
+        PayloadCB(event,
+                  {
+                      {"ret", QString::number(0)},
+                      {"data", eml_data},
+                      {"result_status", QString::number(result_status)},
+                      {"result", result_detail},
+                      {"result_cards",
+                       BuildResultCardsParam(
+                           QApplication::translate("EMailModule",
+                                                   "Sign E-Mail"),
+                           {}, result_cards)},
+                  });
         return 0;
       }
 
@@ -763,79 +975,142 @@ REGISTER_EVENT_HANDLER(
             if (DoSignPlainText(channel, sign_key, meta_data, body_data, event,
                                 result_status, result_detail, result_cards,
                                 eml_data) == kSUCCESS) {
-              CB(event, GFGetModuleID(),
-                 {
-                     {"ret", QString::number(0)},
-                     {"data", eml_data},
-                     {"result_status", QString::number(result_status)},
-                     {"result", result_detail},
-                     {"result_cards",
-                      BuildResultCardsParam(
-                          QApplication::translate("EMailModule", "Sign E-Mail"),
-                          {BuildEMailHeaderCard(meta_data)}, result_cards)},
-                 });
+              PayloadCB(event,
+                        {
+                            {"ret", QString::number(0)},
+                            {"data", eml_data},
+                            {"result_status", QString::number(result_status)},
+                            {"result", result_detail},
+                            {"result_cards",
+                             BuildResultCardsParam(
+                                 QApplication::translate("EMailModule",
+                                                         "Sign E-Mail"),
+                                 {BuildEMailHeaderCard(meta_data)},
+                                 result_cards)},
+                        });
             }
           });
 
-      QObject::connect(r_dialog, &EMailMetaDataDialog::SignalNoEMLMetaData,
-                       r_dialog, [=](const QString& error_string) {
-                         CB(event, GFGetModuleID(),
-                            {
-                                {"ret", QString::number(0)},
-                                {"data", body_data},
-                                {"result_status", QString::number(-1)},
-                                {"result", ErrorHelper(-1, error_string)},
-                            });
-                       });
+      QObject::connect(
+          r_dialog, &EMailMetaDataDialog::SignalNoEMLMetaData, r_dialog,
+          [=](const QString& error_string) {
+            PayloadCB(event, {
+                                 {"ret", QString::number(0)},
+                                 {"data", body_data},
+                                 {"result_status", QString::number(-1)},
+                                 {"result", ErrorHelper(-1, error_string)},
+                             });
+          });
 
       return 0;
     });
 
 namespace {
 
-auto DoEncryptEMLData(int channel, const QStringList& encrypt_keys,
-                      const vmime::shared_ptr<vmime::message>& message,
-                      const QByteArray& body_data, const MEvent& event,
-                      int& result_status, QString& result_detail,
-                      QString& result_cards, QString& eml_data) -> int {
-  gpgme_error_t err;
-  QString capsule_id;
-  auto ret = EncryptEMLData(channel, encrypt_keys, message, body_data, eml_data,
-                            err, capsule_id);
-
+// Report a failed encrypt step to the caller and analyse the capsule of a
+// finished one. Shared by the plain encrypt operations and the encrypt step
+// of the combined Encrypt+Sign operation.
+auto HandleEncryptResult(int channel, int ret, gpgme_error_t err,
+                         const QString& capsule_id, const QString& error_string,
+                         const QByteArray& body_data, const MEvent& event,
+                         int& result_status, QString& result_detail,
+                         QString& result_cards) -> int {
   if (ret == kFAILED || ret == kEML_FAILED) {
-    CB(event, GFGetModuleID(),
-       {
-           {"ret", QString::number(0)},
-           {"data", QString::fromLatin1(body_data.toBase64())},
-           {"result_status", QString::number(-1)},
-           {"result", ErrorHelper(ret, eml_data)},
-       });
+    PayloadCB(event,
+              {
+                  {"ret", QString::number(0)},
+                  {"data", QString::fromLatin1(Base64Encode(body_data))},
+                  {"result_status", QString::number(-1)},
+                  {"result", ErrorHelper(ret, error_string)},
+              });
     return ret;
   }
 
   const char* tmp = nullptr;
   const char* cards_tmp = nullptr;
-  result_status = GFAnalyseEncryptResultByCapsule(
-      channel, err, QDUP(capsule_id), &tmp, &cards_tmp);
+  result_status = WithGpgChannel(channel, [&]() {
+    return GFAnalyseEncryptResultByCapsule(channel, err, QDUP(capsule_id), &tmp,
+                                           &cards_tmp);
+  });
   result_detail = UnStrDup(tmp);
   result_cards = UnStrDup(cards_tmp);
 
   if (ret == kGPG_FAILED) {
     // encrypt failed
-    CB(event, GFGetModuleID(),
-       {
-           {"ret", QString::number(0)},
-           {"data", QString::fromLatin1(body_data.toBase64())},
-           {"result_status", QString::number(result_status)},
-           {"result", result_detail},
-       });
+    PayloadCB(event,
+              {
+                  {"ret", QString::number(0)},
+                  {"data", QString::fromLatin1(Base64Encode(body_data))},
+                  {"result_status", QString::number(result_status)},
+                  {"result", result_detail},
+              });
     return ret;
   }
 
   return kSUCCESS;
 }
 
+// Large messages can be written straight to `output_path` instead of being
+// returned as `data`, the file is only replaced once it is complete.
+auto EncryptToFile(const QString& path,
+                   const std::function<int(QIODevice&, QString&)>& encrypt,
+                   QString& error_string) -> int {
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly)) {
+    error_string = file.errorString();
+    return kFAILED;
+  }
+
+  auto ret = encrypt(file, error_string);
+  if (ret != kSUCCESS) {
+    file.cancelWriting();
+    return ret;
+  }
+
+  if (!file.commit()) {
+    error_string = file.errorString();
+    return kFAILED;
+  }
+  return kSUCCESS;
+}
+
+void InsertEncryptedOutput(const MEvent& event, const QString& eml_data,
+                           QMap<QString, QString>& params) {
+  const auto output_path = event["output_path"];
+  if (output_path.isEmpty()) {
+    params.insert("data", eml_data);
+  } else {
+    params.insert("output_path", output_path);
+  }
+}
+
+auto DoEncryptEMLData(int channel, const QStringList& encrypt_keys,
+                      const vmime::shared_ptr<vmime::message>& message,
+                      const QByteArray& body_data, const MEvent& event,
+                      int& result_status, QString& result_detail,
+                      QString& result_cards, QString& eml_data) -> int {
+  gpgme_error_t err;
+  QString capsule_id;
+  const auto output_path = event["output_path"];
+  auto encrypt = [&](QIODevice& device, QString& error_string) -> int {
+    return EncryptEMLDataTo(channel, encrypt_keys, message, body_data, device,
+                            error_string, err, capsule_id);
+  };
+
+  int ret = kEML_FAILED;
+  if (EMailOpCheckpoint(eml_data) &&
+      ParseEMLBody(body_data, message, eml_data)) {
+    ret = output_path.isEmpty()
+              ? EncryptEMLData(channel, encrypt_keys, message, body_data,
+                               eml_data, err, capsule_id)
+              : EncryptToFile(output_path, encrypt, eml_data);
+  }
+
+  return HandleEncryptResult(channel, ret, err, capsule_id, eml_data,
+                             body_data, event, result_status, result_detail,
+                             result_cards);
+}
+
 auto DoEncryptPlainText(int channel, const QStringList& encrypt_keys,
                         const EMailMetaData& meta_data,
                         const QByteArray& body_data, const MEvent& event,
@@ -847,57 +1122,38 @@ auto DoEncryptPlainText(int channel, const QStringList& encrypt_keys,
   auto ret = BuildPlainTextEML(meta_data, body_data, plain_text_eml_data);
 
   if (ret != kSUCCESS) {
-    CB(event, GFGetModuleID(),
-       {
-           {"ret", QString::number(0)},
-           {"data", QString::fromLatin1(body_data.toBase64())},
-           {"result_status", QString::number(-1)},
-           {"result", ErrorHelper(ret, eml_data)},
-       });
+    PayloadCB(event,
+              {
+                  {"ret", QString::number(0)},
+                  {"data", QString::fromLatin1(Base64Encode(body_data))},
+                  {"result_status", QString::number(-1)},
+                  {"result", ErrorHelper(ret, eml_data)},
+              });
     return ret;
   }
 
-  ret = EncryptPlainText(channel, encrypt_keys, meta_data,
-                         plain_text_eml_data.toLatin1(), eml_data, err,
-                         capsule_id);
-
-  if (ret == kFAILED || ret == kEML_FAILED) {
-    CB(event, GFGetModuleID(),
-       {
-           {"ret", QString::number(0)},
-           {"data", QString::fromLatin1(body_data.toBase64())},
-           {"result_status", QString::number(-1)},
-           {"result", ErrorHelper(ret, eml_data)},
-       });
-    return ret;
-  }
-
-  const char* tmp = nullptr;
-  const char* cards_tmp = nullptr;
-  result_status = GFAnalyseEncryptResultByCapsule(
-      channel, err, QDUP(capsule_id), &tmp, &cards_tmp);
-  result_detail = UnStrDup(tmp);
-  result_cards = UnStrDup(cards_tmp);
-
-  if (ret == kGPG_FAILED) {
-    // encrypt failed
-    CB(event, GFGetModuleID(),
-       {
-           {"ret", QString::number(0)},
-           {"data", QString::fromLatin1(body_data.toBase64())},
-           {"result_status", QString::number(result_status)},
-           {"result", result_detail},
-       });
-    return ret;
-  }
-
-  return kSUCCESS;
+  const auto output_path = event["output_path"];
+  const auto plain_text = plain_text_eml_data.toLatin1();
+  auto encrypt = [&](QIODevice& device, QString& error_string) -> int {
+    return EncryptPlainTextTo(channel, encrypt_keys, meta_data, plain_text,
+                              device, error_string, err, capsule_id);
+  };
+
+  ret = output_path.isEmpty()
+            ? EncryptPlainText(channel, encrypt_keys, meta_data, plain_text,
+                               eml_data, err, capsule_id)
+            : EncryptToFile(output_path, encrypt, eml_data);
+
+  return HandleEncryptResult(channel, ret, err, capsule_id, eml_data,
+                             body_data, event, result_status, result_detail,
+                             result_cards);
 }
 };  // namespace
 
 REGISTER_EVENT_HANDLER(
     EDIT_TAB_TYPE_EMAIL_OP_ENCRYPT, [](const MEvent& event) -> int {
-      if (event["body_data"].isEmpty()) CB_ERR(event, -1, "body_data is empty");
+      if (!HasEventPayload(event, "body_data"))
+        CB_ERR(event, -1, "body_data is empty");
       if (event["channel"].isEmpty()) CB_ERR(event, -1, "channel is empty");
       if (event["encrypt_keys"].isEmpty())
         CB_ERR(event, -1, "encrypt_keys is empty");
@@ -907,8 +1163,7 @@ REGISTER_EVENT_HANDLER(
 
       FLOG_DEBUG("eml encrypt keys: %1", encrypt_keys.join(';'));
 
-      auto body_data =
-          QByteArray::fromBase64(QString(event["body_data"]).toLatin1());
+      auto body_data = ReadEventPayload(event, "body_data");
 
       vmime::shared_ptr<vmime::message> message;
       if (CheckIfEMLMessage(body_data, message)) {
@@ -922,17 +1177,17 @@ REGISTER_EVENT_HANDLER(
           return -1;
         }
 
-        CB(event, GFGetModuleID(),
-           {
-               {"ret", QString::number(0)},
-               {"data", eml_data},
-               {"result", result_detail},
-               {"result_status", QString::number(result_status)},
-               {"result_cards",
-                BuildResultCardsParam(
-                    QApplication::translate("EMailModule", "Encrypt E-Mail"),
-                    BuildRecipientCards(channel, encrypt_keys), result_cards)},
-           });
+        QMap<QString, QString> params{
+            {"ret", QString::number(0)},
+            {"result", result_detail},
+            {"result_status", QString::number(result_status)},
+            {"result_cards",
+             BuildResultCardsParam(
+                 QApplication::translate("EMailModule", "Encrypt E-Mail"),
+                 BuildRecipientCards(channel, encrypt_keys), result_cards)},
+        };
+        InsertEncryptedOutput(event, eml_data, params);
+        PayloadCB(event, params);
         return 0;
       }
 
@@ -960,113 +1215,213 @@ REGISTER_EVENT_HANDLER(
                                    result_cards, eml_data) == kSUCCESS) {
               auto meta_cards = BuildRecipientCards(channel, encrypt_keys);
               meta_cards.prepend(BuildEMailHeaderCard(meta_data));
-              CB(event, GFGetModuleID(),
-                 {
-                     {"ret", QString::number(0)},
-                     {"data", eml_data},
-                     {"result", result_detail},
-                     {"result_status", QString::number(result_status)},
-                     {"result_cards", BuildResultCardsParam(
-                                          QApplication::translate(
-                                              "EMailModule", "Encrypt E-Mail"),
-                                          meta_cards, result_cards)},
-                 });
+              QMap<QString, QString> params{
+                  {"ret", QString::number(0)},
+                  {"result", result_detail},
+                  {"result_status", QString::number(result_status)},
+                  {"result_cards",
+                   BuildResultCardsParam(
+                       QApplication::translate("EMailModule", "Encrypt E-Mail"),
+                       meta_cards, result_cards)},
+              };
+              InsertEncryptedOutput(event, eml_data, params);
+              PayloadCB(event, params);
             }
           });
 
       QObject::connect(
           r_dialog, &EMailMetaDataDialog::SignalNoEMLMetaData, r_dialog,
           [=](const QString& error_string) {
-            CB(event, GFGetModuleID(),
-               {
-                   {"ret", QString::number(0)},
-                   {"data", QString::fromLatin1(body_data.toBase64())},
-                   {"result_status", QString::number(-1)},
-                   {"result", ErrorHelper(-1, error_string)},
-               });
+            PayloadCB(event,
+                      {
+                          {"ret", QString::number(0)},
+                          {"data",
+                           QString::fromLatin1(Base64Encode(body_data))},
+                          {"result_status", QString::number(-1)},
+                          {"result", ErrorHelper(-1, error_string)},
+                      });
           });
 
       return 0;
     });
 
+// One encrypted EML per recipient key, for gateways that must not reveal the
+// other recipients. Each message is returned as data_<i> (or the error as
+// result_<i>) with its key_<i> and result_status_<i>. The outer headers name
+// no recipient, the gateway addresses each copy itself.
+REGISTER_EVENT_HANDLER(
+    EMAIL_OP_ENCRYPT_PER_RECIPIENT, [](const MEvent& event) -> int {
+      if (!HasEventPayload(event, "body_data"))
+        CB_ERR(event, -1, "body_data is empty");
+      if (event["channel"].isEmpty()) CB_ERR(event, -1, "channel is empty");
+
+      auto channel = event.value("channel", "0").toInt();
+      auto encrypt_keys =
+          event.value("encrypt_keys", "").split(';', Qt::SkipEmptyParts);
+      if (encrypt_keys.isEmpty()) CB_ERR(event, -1, "encrypt_keys is empty");
+
+      auto body_data = ReadEventPayload(event, "body_data");
+
+      QString error_string;
+      QList<EMailRecipientEML> results;
+      vmime::shared_ptr<vmime::message> message;
+      auto ret = CheckIfEMLMessage(body_data, message) &&
+                         EMailOpCheckpoint(error_string) &&
+                         ParseEMLBody(body_data, message, error_string)
+                     ? EncryptEMLDataPerRecipient(channel, encrypt_keys,
+                                                  message, body_data, results,
+                                                  error_string)
+                     : kEML_FAILED;
+      if (ret != kSUCCESS) {
+        PayloadCB(event,
+                  {
+                      {"ret", QString::number(0)},
+                      {"result_status", QString::number(-1)},
+                      {"result", ErrorHelper(ret, error_string)},
+                  });
+        return -1;
+      }
+
+      QMap<QString, QString> params{
+          {"ret", QString::number(0)},
+          {"count", QString::number(results.size())},
+      };
+      int result_status = 1;
+      QString report;
+      QString crypto_cards = "[";
+      for (qsizetype i = 0; i < results.size(); i++) {
+        const auto& r = results[i];
+        const auto suffix = QString("_%1").arg(i);
+
+        int status = -1;
+        if (r.ret == kSUCCESS || r.ret == kGPG_FAILED) {
+          const char* tmp = nullptr;
+          const char* cards_tmp = nullptr;
+          status = WithGpgChannel(channel, [&]() {
+            return GFAnalyseEncryptResultByCapsule(channel, r.err,
+                                                   QDUP(r.capsule_id), &tmp,
+                                                   &cards_tmp);
+          });
+          UDUP(tmp);
+          AppendArrayElements(crypto_cards, ArrayElements(UDUP(cards_tmp)));
+        }
+        if (r.ret != kSUCCESS) status = std::min(status, -1);
+        result_status = std::min(result_status, status);
+
+        params.insert("key" + suffix, r.key);
+        params.insert("result_status" + suffix, QString::number(status));
+        params.insert((r.ret == kSUCCESS ? "data" : "result") + suffix,
+                      r.eml_data);
+        AppendMarkdownField(
+            report, r.key,
+            r.ret == kSUCCESS
+                ? QApplication::translate("EMailModule", "Encrypted")
+                : r.eml_data);
+      }
+      crypto_cards += ']';
+
+      params.insert("result_status", QString::number(result_status));
+      params.insert("result", report);
+      params.insert(
+          "result_cards",
+          BuildResultCardsParam(
+              QApplication::translate("EMailModule",
+                                      "Encrypt E-Mail per Recipient"),
+              BuildRecipientCards(channel, encrypt_keys), crypto_cards));
+      PayloadCB(event, params);
+      return 0;
+    });
+
 namespace {
 
+// The signed message is encrypted straight from its in-memory object graph:
+// no serialize/parse cycle between the two steps and the signed form is
+// generated exactly once, as the plaintext that goes into the encryption.
 auto DoEncryptSignEMLData(int channel, const QStringList& encrypt_keys,
                           const QString& sign_key,
-                          vmime::shared_ptr<vmime::message>& message,
-                          QByteArray& body_data, const MEvent& event,
-                          int result_status, QString& result_detail,
+                          const vmime::shared_ptr<vmime::message>& message,
+                          const QByteArray& body_data, const MEvent& event,
+                          int& result_status, QString& result_detail,
                           QString& result_cards, QString& eml_data) -> int {
+  gpgme_error_t err;
+  QString capsule_id;
+  QString error_string;
   QString sign_cards;
-  if (DoSignEMLData(channel, sign_key, message, body_data, event, result_status,
-                    result_detail, sign_cards, eml_data) != kSUCCESS) {
+
+  auto ret = EMailOpCheckpoint(error_string) &&
+                    ParseEMLBody(body_data, message, error_string)
+                 ? SignEMLMessage(channel, sign_key, message, error_string,
+                                  err, capsule_id)
+                 : kEML_FAILED;
+  if (HandleSignResult(channel, ret, err, capsule_id, error_string, body_data,
+                       event, result_status, result_detail,
+                       sign_cards) != kSUCCESS) {
     return -1;
   }
 
-  body_data = eml_data.toLatin1();
-  eml_data.clear();
-
   int t_result_status;
   QString t_result_detail;
   QString encrypt_cards;
 
-  vmime::shared_ptr<vmime::message> signed_message;
-  bool r = CheckIfEMLMessage(body_data, signed_message);
-  if (!r) {
-    CB_ERR(event, -1, "Parse Signed Message Failed");
+  ret = EncryptEMLMessage(channel, encrypt_keys, message, eml_data, err,
+                          capsule_id);
+  if (HandleEncryptResult(channel, ret, err, capsule_id, eml_data, body_data,
+                          event, t_result_status, t_result_detail,
+                          encrypt_cards) != kSUCCESS) {
+    return -1;
   }
 
-  auto ret = DoEncryptEMLData(channel, encrypt_keys, signed_message, body_data,
-                              event, t_result_status, t_result_detail,
-                              encrypt_cards, eml_data);
-
   result_status = std::min(t_result_status, result_status);
   result_detail = t_result_detail + "\n\n" + result_detail;
   result_cards = MergeCardArrays(encrypt_cards, sign_cards);
-  return ret;
+  return kSUCCESS;
 }
 
 auto DoEncryptSignPlainText(int channel, const QStringList& encrypt_keys,
                             const QString& sign_key,
                             const EMailMetaData& meta_data,
-                            QByteArray& body_data, const MEvent& event,
+                            const QByteArray& body_data, const MEvent& event,
                             int& result_status, QString& result_detail,
                             QString& result_cards, QString& eml_data) -> int {
+  gpgme_error_t err;
+  QString capsule_id;
+  QString error_string;
   QString sign_cards;
-  if (DoSignPlainText(channel, sign_key, meta_data, body_data, event,
-                      result_status, result_detail, sign_cards,
-                      eml_data) != kSUCCESS) {
+
+  vmime::shared_ptr<vmime::message> signed_message;
+  auto ret = SignPlainTextMessage(channel, sign_key, meta_data, body_data,
+                                  signed_message, error_string, err,
+                                  capsule_id);
+  if (HandleSignResult(channel, ret, err, capsule_id, error_string, body_data,
+                       event, result_status, result_detail,
+                       sign_cards) != kSUCCESS) {
     return -1;
   }
 
-  body_data = eml_data.toLatin1();
-  eml_data.clear();
-
   int t_result_status;
   QString t_result_detail;
   QString encrypt_cards;
 
-  vmime::shared_ptr<vmime::message> signed_message;
-  bool r = CheckIfEMLMessage(body_data, signed_message);
-  if (!r) {
-    CB_ERR(event, -1, "Parse Signed Message Failed");
+  ret = EncryptEMLMessage(channel, encrypt_keys, signed_message, eml_data, err,
+                          capsule_id);
+  if (HandleEncryptResult(channel, ret, err, capsule_id, eml_data, body_data,
+                          event, t_result_status, t_result_detail,
+                          encrypt_cards) != kSUCCESS) {
+    return -1;
   }
 
-  auto ret = DoEncryptEMLData(channel, encrypt_keys, signed_message, body_data,
-                              event, t_result_status, t_result_detail,
-                              encrypt_cards, eml_data);
-
   result_status = std::min(t_result_status, result_status);
   result_detail = t_result_detail + "\n" + result_detail;
   result_cards = MergeCardArrays(encrypt_cards, sign_cards);
-  return ret;
+  return kSUCCESS;
 }
 
 }  // namespace
 
 REGISTER_EVENT_HANDLER(
     EDIT_TAB_TYPE_EMAIL_OP_ENCRYPT_SIGN, [](const MEvent& event) -> int {
-      if (event["body_data"].isEmpty()) CB_ERR(event, -1, "body_data is empty");
+      if (!HasEventPayload(event, "body_data"))
+        CB_ERR(event, -1, "body_data is empty");
       if (event["channel"].isEmpty()) CB_ERR(event, -1, "channel is empty");
       if (event["encrypt_keys"].isEmpty())
         CB_ERR(event, -1, "encrypt_keys is empty");
@@ -1078,8 +1433,7 @@ REGISTER_EVENT_HANDLER(
 
       FLOG_DEBUG("eml encrypt keys: %1", encrypt_keys.join(';'));
 
-      auto body_data =
-          QByteArray::fromBase64(QString(event["body_data"]).toLatin1());
+      auto body_data = ReadEventPayload(event, "body_data");
 
       vmime::shared_ptr<vmime::message> message;
       if (CheckIfEMLMessage(body_data, message)) {
@@ -1092,18 +1446,19 @@ REGISTER_EVENT_HANDLER(
                                  result_cards, eml_data) != kSUCCESS) {
           return -1;
         }
-        CB(event, GFGetModuleID(),
-           {
-               {"ret", QString::number(0)},
-               {"data", eml_data},
-               {"result", result_detail},
-               {"result_status", QString::number(result_status)},
-               {"result_cards",
-                BuildResultCardsParam(
-                    QApplication::translate("EMailModule",
-                                            "Encrypt and Sign E-Mail"),
-                    BuildRecipientCards(channel, encrypt_keys), result_cards)},
-           });
+        PayloadCB(event,
+                  {
+                      {"ret", QString::number(0)},
+                      {"data", eml_data},
+                      {"result", result_detail},
+                      {"result_status", QString::number(result_status)},
+                      {"result_cards",
+                       BuildResultCardsParam(
+                           QApplication::translate("EMailModule",
+                                                   "Encrypt and Sign E-Mail"),
+                           BuildRecipientCards(channel, encrypt_keys),
+                           result_cards)},
+                  });
         return 0;
       }
 
@@ -1127,43 +1482,43 @@ REGISTER_EVENT_HANDLER(
             int result_status = 0;
             QString result_detail;
             QString result_cards;
-            QByteArray body_data_copy = body_data;
 
             FLOG_DEBUG("meta data, from: %1", meta_data.from);
 
             if (DoEncryptSignPlainText(channel, encrypt_keys, sign_key,
-                                       meta_data, body_data_copy, event,
+                                       meta_data, body_data, event,
                                        result_status, result_detail,
                                        result_cards, eml_data) != kSUCCESS) {
               return -1;
             }
             auto meta_cards = BuildRecipientCards(channel, encrypt_keys);
             meta_cards.prepend(BuildEMailHeaderCard(meta_data));
-            CB(event, GFGetModuleID(),
-               {
-                   {"ret", QString::number(0)},
-                   {"data", eml_data},
-                   {"result", result_detail},
-                   {"result_status", QString::number(result_status)},
-                   {"result_cards",
-                    BuildResultCardsParam(
-                        QApplication::translate("EMailModule",
-                                                "Encrypt and Sign E-Mail"),
-                        meta_cards, result_cards)},
-               });
+            PayloadCB(event,
+                      {
+                          {"ret", QString::number(0)},
+                          {"data", eml_data},
+                          {"result", result_detail},
+                          {"result_status", QString::number(result_status)},
+                          {"result_cards",
+                           BuildResultCardsParam(
+                               QApplication::translate(
+                                   "EMailModule", "Encrypt and Sign E-Mail"),
+                               meta_cards, result_cards)},
+                      });
             return 0;
           });
 
       QObject::connect(
           r_dialog, &EMailMetaDataDialog::SignalNoEMLMetaData, r_dialog,
           [=](const QString& error_string) {
-            CB(event, GFGetModuleID(),
-               {
-                   {"ret", QString::number(0)},
-                   {"data", QString::fromLatin1(body_data.toBase64())},
-                   {"result_status", QString::number(-1)},
-                   {"result", ErrorHelper(-1, error_string)},
-               });
+            PayloadCB(event,
+                      {
+                          {"ret", QString::number(0)},
+                          {"data",
+                           QString::fromLatin1(Base64Encode(body_data))},
+                          {"result_status", QString::number(-1)},
+                          {"result", ErrorHelper(-1, error_string)},
+                      });
           });
 
       return 0;
@@ -1182,13 +1537,29 @@ auto DoDecryptVerifyEMLData(int channel, const QByteArray& data,
     return -1;
   }
 
+  // The decrypted entity stays out of the cache, plaintext must not outlive
+  // the operation.
+  EMailParsedMessagePtr inner;
+  try {
+    inner = ParseEMailMessage(eml_data.toUtf8());
+  } catch (const vmime::exception& e) {
+    FLOG_DEBUG("error when parsing decrypted data: %1", e.what());
+  }
+  if (inner == nullptr || !IsSignedEMLMessage(*inner)) {
+    // signed and encrypted in one OpenPGP message (RFC 3156 6.2) or not
+    // signed at all: there is no nested multipart/signed to check
+    FLOG_DEBUG("decrypted data carries no multipart/signed entity");
+    result_cards = decrypt_cards;
+    return kSUCCESS;
+  }
+
   int t_result_status;
   QString t_result_detail;
   QString verify_cards;
 
-  if (DoVerifyEMLData(channel, eml_data.toLatin1(), event, t_result_status,
-                      t_result_detail, verify_cards, error_string,
-                      meta_data) != kSUCCESS) {
+  if (DoVerifyEMLMessage(channel, inner, event, t_result_status,
+                         t_result_detail, verify_cards, error_string,
+                         meta_data) != kSUCCESS) {
     return -1;
   }
 
@@ -1203,13 +1574,12 @@ auto DoDecryptVerifyEMLData(int channel, const QByteArray& data,
 REGISTER_EVENT_HANDLER(
     EDIT_TAB_TYPE_EMAIL_OP_DECRYPT_VERIFY, [](const MEvent& event) -> int {
       if (event["channel"].isEmpty()) CB_ERR(event, -1, "channel is empty");
-      if (event["data"].isEmpty()) CB_ERR(event, -1, "data is empty");
+      if (!HasEventPayload(event, "data")) CB_ERR(event, -1, "data is empty");
 
       auto channel = event.value("channel", "0").toInt();
-      auto data = QByteArray::fromBase64(QString(event["data"]).toLatin1());
+      auto data = ReadEventPayload(event, "data");
 
-      auto body_data =
-          QByteArray::fromBase64(QString(event["body_data"]).toLatin1());
+      auto body_data = ReadEventPayload(event, "body_data");
 
       QString eml_data;
       EMailMetaData meta_data;
@@ -1224,45 +1594,7 @@ REGISTER_EVENT_HANDLER(
         return -1;
       }
 
-      QString email_info;
-      email_info.append("# E-Mail Information\n\n");
-      email_info.append(QString("- %1: %2\n")
-                            .arg(QApplication::translate("EMailModule", "From"))
-                            .arg(meta_data.from));
-      email_info.append(QString("- %1: %2\n")
-                            .arg(QApplication::translate("EMailModule", "To"))
-                            .arg(meta_data.to.join("; ")));
-      email_info.append(
-          QString("- %1: %2\n")
-              .arg(QApplication::translate("EMailModule", "Subject"))
-              .arg(meta_data.subject));
-      email_info.append(QString("- %1: %2\n")
-                            .arg(QApplication::translate("EMailModule", "CC"))
-                            .arg(meta_data.cc.join("; ")));
-      email_info.append(QString("- %1: %2\n")
-                            .arg(QApplication::translate("EMailModule", "BCC"))
-                            .arg(meta_data.bcc.join("; ")));
-      email_info.append(QString("- %1: %2\n")
-                            .arg(QApplication::translate("EMailModule", "Date"))
-                            .arg(QLocale().toString(meta_data.datetime)));
-
-      email_info.append("\n");
-
-      email_info.append("# OpenPGP Information\n\n");
-
-      email_info.append(QString("- %1: %2\n")
-                            .arg(QApplication::translate(
-                                "EMailModule", "Signed EML Data Hash (SHA1)"))
-                            .arg(meta_data.mime_hash));
-      email_info.append(
-          QString("- %1: %2\n")
-              .arg(QApplication::translate("EMailModule",
-                                           "Message Integrity Check Algorithm"))
-              .arg(meta_data.micalg));
-
-      email_info.append("\n");
-
-      email_info.append("#" + result_detail + "\n");
+      const auto email_info = BuildEMailInfo(meta_data, result_detail, true);
 
       const auto result_cards_param = BuildResultCardsParam(
           QApplication::translate("EMailModule", "Decrypt and Verify E-Mail"),
@@ -1270,17 +1602,54 @@ REGISTER_EVENT_HANDLER(
           result_cards);
 
       // callback
-      CB(event, GFGetModuleID(),
-         {
-             {"ret", QString::number(0)},
-             {"data", eml_data},
-             {"result_status", QString::number(result_status)},
-             {"result", email_info},
-             {"result_cards", result_cards_param},
-         });
+      PayloadCB(event,
+                {
+                    {"ret", QString::number(0)},
+                    {"data", eml_data},
+                    {"result_status", QString::number(result_status)},
+                    {"result", email_info},
+                    {"result_cards", result_cards_param},
+                });
       return 0;
     });
 
+namespace {
+
+/**
+ * @brief write the document block by block as CRLF terminated UTF-8 through
+ * a fixed size buffer, so memory does not grow with the document
+ *
+ * @param document
+ * @param device
+ * @return true
+ * @return false
+ */
+auto WriteDocumentAsEML(const QTextDocument* document, QIODevice& device)
+    -> bool {
+  constexpr qsizetype kChunkSize = 64 * 1024;
+
+  QByteArray chunk;
+  chunk.reserve(kChunkSize + 1024);
+
+  for (auto block = document->begin(); block.isValid();
+       block = block.next()) {
+    // same characters toPlainText() would substitute
+    auto text = block.text();
+    text.replace(QChar::Nbsp, ' ');
+    text.replace(QChar::LineSeparator, QLatin1String("\r\n"));
+    chunk.append(text.toUtf8());
+    if (block.next().isValid()) chunk.append("\r\n");
+
+    if (chunk.size() < kChunkSize) continue;
+    if (device.write(chunk) != chunk.size()) return false;
+    chunk.resize(0);  // keeps the reserved capacity
+  }
+
+  return chunk.isEmpty() || device.write(chunk) == chunk.size();
+}
+
+}  // namespace
+
 REGISTER_EVENT_HANDLER(
     EDIT_TAB_TYPE_EMAIL_OP_SAVE_FILE, [](const MEvent& event) -> int {
       if (event["page"].isEmpty()) CB_ERR(event, -1, "page is empty");
@@ -1337,16 +1706,6 @@ REGISTER_EVENT_HANDLER(
         FLOG_DEBUG("append .eml suffix to filename: %1", filename);
       }
 
-      QFile file(filename);
-      if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QMessageBox::warning(
-            page, QApplication::translate("EMailModule", "Warning"),
-            QApplication::translate("EMailModule", "Cannot read file%1:\n%2.")
-                .arg(filename)
-                .arg(file.errorString()));
-        return false;
-      }
-
       QPlainTextEdit* text_edit = nullptr;
       ok = QMetaObject::invokeMethod(page, "GetTextPage",
                                      Qt::BlockingQueuedConnection,
@@ -1356,13 +1715,38 @@ REGISTER_EVENT_HANDLER(
         CB_ERR(event, -1, "invoke GetTextPage failed");
       }
 
-      QTextStream output_stream(&file);
-      QApplication::setOverrideCursor(Qt::WaitCursor);
-      output_stream << text_edit->toPlainText().replace("\n", "\r\n").toUtf8();
-      QApplication::restoreOverrideCursor();
-      QTextDocument* document = text_edit->document();
+      // written to a temporary file and renamed over the target on commit,
+      // an interrupted save never leaves a truncated file behind
+      QSaveFile file(filename);
+      if (!file.open(QIODevice::WriteOnly)) {
+        QMessageBox::warning(
+            page, QApplication::translate("EMailModule", "Warning"),
+            QApplication::translate("EMailModule", "Cannot read file%1:\n%2.")
+                .arg(filename)
+                .arg(file.errorString()));
+        return false;
+      }
 
-      document->setModified(false);
+      // the document belongs to the GUI thread
+      bool written = false;
+      ok = QMetaObject::invokeMethod(
+          QCoreApplication::instance(),
+          [&]() -> void {
+            QApplication::setOverrideCursor(Qt::WaitCursor);
+            written = WriteDocumentAsEML(text_edit->document(), file);
+            if (written) text_edit->document()->setModified(false);
+            QApplication::restoreOverrideCursor();
+          },
+          Qt::BlockingQueuedConnection);
+
+      if (!ok || !written || !file.commit()) {
+        QMessageBox::warning(
+            page, QApplication::translate("EMailModule", "Warning"),
+            QApplication::translate("EMailModule", "Cannot save file %1:\n%2.")
+                .arg(filename)
+                .arg(file.errorString()));
+        CB_ERR(event, -1, "cannot write file");
+      }
 
       int cur_index = tab_widget->currentIndex();
       tab_widget->setTabText(cur_index, QFileInfo(filename).fileName());
@@ -1380,20 +1764,11 @@ REGISTER_EVENT_HANDLER(
       if (event["file_path"].isEmpty()) CB_ERR(event, -1, "file_path is empty");
 
       auto file_path = event.value("file_path", "");
-      QFileInfo file_info(file_path);
 
-      // stop here if file is too large (> 1mb)
-      if (file_info.size() > static_cast<qint64>(1 * 1024 * 1024)) {
-        QMessageBox::warning(
-            nullptr, QApplication::translate("EMailModule", "Warning"),
-            QApplication::translate(
-                "EMailModule",
-                "The file %1 is too large (%2 bytes) to be opened. The "
-                "maximum allowed size is 1 MB.")
-                .arg(file_path)
-                .arg(file_info.size()));
-        return -1;
-      }
+      // the tab's operations run on the current context unless told otherwise
+      auto channel = event["channel"].isEmpty()
+                         ? GFGpgCurrentGpgContextChannel()
+                         : event["channel"].toInt();
 
       auto* edit = GFUIGetGUIObjectAs<QWidget>("main_window_edit");
       if (!edit) {
@@ -1409,14 +1784,14 @@ REGISTER_EVENT_HANDLER(
       // Run in GUI thread to avoid blocking the main thread
       QMetaObject::invokeMethod(QCoreApplication::instance(), [=]() -> void {
         QFileInfo file_info(file_path);
-        QFile file(file_path);
-        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        if (!file_info.isReadable()) {
           QMessageBox::warning(
               nullptr, QApplication::translate("EMailModule", "Warning"),
               QApplication::translate("EMailModule",
                                       "Cannot read file %1:\n%2.")
                   .arg(file_path)
-                  .arg(file.errorString()));
+                  .arg(QApplication::translate("EMailModule",
+                                               "File is not readable")));
           return;
         }
 
@@ -1445,12 +1820,284 @@ REGISTER_EVENT_HANDLER(
           return;
         }
 
-        text_edit->setPlainText(
-            QString::fromUtf8(file.readAll()).replace("\r\n", "\n"));
-        text_edit->document()->setModified(false);
+        // the editor is filled chunk by chunk from the event loop, so large
+        // files neither block the GUI thread nor get copied as a whole
+        auto* loader = new EMailFileLoader(file_path, text_edit, page);
+
+        QObject::connect(loader, &EMailFileLoader::SignalLoadFinished, page,
+                         [page, file_path, channel]() {
+                           QMetaObject::invokeMethod(
+                               page, "SetFilePath", Qt::DirectConnection,
+                               Q_ARG(QString, file_path));
+                           AttachLiveVerifier(page, channel);
+                         });
+
+        QObject::connect(loader, &EMailFileLoader::SignalLoadFailed, page,
+                         [file_path](const QString& error_string) {
+                           QMessageBox::warning(
+                               nullptr,
+                               QApplication::translate("EMailModule",
+                                                       "Warning"),
+                               QApplication::translate(
+                                   "EMailModule", "Cannot read file %1:\n%2.")
+                                   .arg(file_path)
+                                   .arg(error_string));
+                         });
+
+        if (!loader->Start()) {
+          QMessageBox::warning(
+              nullptr, QApplication::translate("EMailModule", "Warning"),
+              QApplication::translate("EMailModule",
+                                      "Cannot read file %1:\n%2.")
+                  .arg(file_path)
+                  .arg(loader->ErrorString()));
+          loader->deleteLater();
+          return;
+        }
+      });
+      return 0;
+    });
+
+namespace {
 
-        QMetaObject::invokeMethod(page, "SetFilePath", Qt::DirectConnection,
-                                  Q_ARG(QString, file_path));
+auto BatchCardStatus(int result_status) -> QString {
+  if (result_status > 0) return "ok";
+  if (result_status == 0) return "warning";
+  return "error";
+}
+
+void AppendCardArray(QJsonArray& cards, const QString& cards_json) {
+  if (cards_json.isEmpty()) return;
+  const auto doc = QJsonDocument::fromJson(cards_json.toUtf8());
+  if (!doc.isArray()) return;
+  for (const auto& v : doc.array()) cards.append(v);
+}
+
+// One summary card, then a card per PGP/MIME message followed by the crypto
+// cards of its decryption and verification. Plain messages are only counted.
+auto BuildBatchReport(const QList<EMailBatchResult>& results,
+                      const EMailBatchSummary& summary, int& result_status,
+                      QString& result_cards) -> QString {
+  const auto yes_no = [](bool b) {
+    return b ? QApplication::translate("EMailModule", "Yes")
+             : QApplication::translate("EMailModule", "No");
+  };
+
+  result_status = summary.total - summary.skipped > 0 ? 1 : 0;
+  if (summary.cancelled) result_status = std::min(result_status, 0);
+
+  QString report;
+  QJsonArray message_cards;
+  for (const auto& r : results) {
+    if (r.skipped) continue;
+    result_status = std::min(result_status, r.result_status);
+
+    message_cards.append(MakeCardJson(
+        r.subject.isEmpty() ? r.source : r.subject,
+        BatchCardStatus(r.result_status),
+        {{QApplication::translate("EMailModule", "Source"), r.source},
+         {QApplication::translate("EMailModule", "From"), r.from},
+         {QApplication::translate("EMailModule", "Error"), r.error_string}}));
+    AppendCardArray(message_cards, r.decrypt_cards);
+    AppendCardArray(message_cards, r.verify_cards);
+
+    if (r.result_status < 0) {
+      AppendMarkdownField(
+          report, r.source,
+          r.error_string.isEmpty() ? r.subject : r.error_string);
+    }
+  }
+
+  const QList<QPair<QString, QString>> counts = {
+      {QApplication::translate("EMailModule", "Messages"),
+       QString::number(summary.total)},
+      {QApplication::translate("EMailModule", "Decrypted"),
+       QString::number(summary.decrypted)},
+      {QApplication::translate("EMailModule", "Verified"),
+       QString::number(summary.verified)},
+      {QApplication::translate("EMailModule", "Not PGP/MIME"),
+       QString::number(summary.skipped)},
+      {QApplication::translate("EMailModule", "Failed"),
+       QString::number(summary.failed)},
+      {QApplication::translate("EMailModule", "Cancelled"),
+       yes_no(summary.cancelled)},
+  };
+
+  QString email_info;
+  email_info.append("# Mailbox Information\n\n");
+  for (const auto& c : counts) {
+    AppendMarkdownField(email_info, c.first, c.second);
+  }
+  if (!report.isEmpty()) {
+    email_info.append("\n# Failed Messages\n\n");
+    email_info.append(report);
+  }
+
+  QJsonArray cards{MakeCardJson(
+      QApplication::translate("EMailModule", "Mailbox"),
+      BatchCardStatus(result_status), counts)};
+  for (const auto& v : message_cards) cards.append(v);
+
+  result_cards = BuildResultCardsParam(
+      QApplication::translate("EMailModule", "Verify and Decrypt Mailbox"),
+      cards, {});
+  return email_info;
+}
+
+}  // namespace
+
+REGISTER_EVENT_HANDLER(
+    EMAIL_OP_BATCH_VERIFY_DECRYPT, [](const MEvent& event) -> int {
+      if (event["channel"].isEmpty()) CB_ERR(event, -1, "channel is empty");
+      if (event["path"].isEmpty()) CB_ERR(event, -1, "path is empty");
+
+      auto channel = event.value("channel", "0").toInt();
+      auto path = event["path"];
+      auto max_threads = event.value("max_threads", "0").toInt();
+      auto batch_id = event["trigger_id"];
+      if (batch_id.isEmpty()) CB_ERR(event, -1, "trigger_id is empty");
+
+      // the trigger id is also the batch id EMAIL_OP_BATCH_CANCEL takes
+      auto cancel_flag = RegisterOpCancelFlag(batch_id);
+      if (cancel_flag == nullptr) {
+        CB_ERR(event, -1, "trigger_id is already running");
+      }
+
+      // a mailbox may take minutes, reply from the pool once it is done
+      QThreadPool::globalInstance()->start([=]() {
+        // progress is published as "<done>/<total>"
+        const auto progress_key =
+            QString("email.batch.%1.progress").arg(batch_id);
+        auto on_progress = [progress_key](qsizetype done, qsizetype total) {
+          GFModuleUpsertRTValue(GFGetModuleID(), QDUP(progress_key),
+                                QDUP(QString("%1/%2").arg(done).arg(total)));
+        };
+
+        QList<EMailBatchResult> results;
+        EMailBatchSummary summary;
+        auto ret = BatchVerifyDecryptEMails(channel, path, max_threads,
+                                            cancel_flag, on_progress, results,
+                                            summary);
+
+        {
+          QMutexLocker locker(&op_cancel_flags_mutex);
+          op_cancel_flags.remove(batch_id);
+        }
+
+        if (ret != kSUCCESS) {
+          CB_ERR_NO_RET(event, -1, "cannot read mailbox");
+          return;
+        }
+
+        int result_status;
+        QString result_cards;
+        auto email_info =
+            BuildBatchReport(results, summary, result_status, result_cards);
+
+        CB(event, GFGetModuleID(),
+           {
+               {"ret", QString::number(0)},
+               {"result_status", QString::number(result_status)},
+               {"result", email_info},
+               {"result_cards", result_cards},
+           });
       });
       return 0;
-    })
\ No newline at end of file
+    });
+
+REGISTER_EVENT_HANDLER(EMAIL_OP_BATCH_CANCEL, [](const MEvent& event) -> int {
+  if (event["batch_id"].isEmpty()) CB_ERR(event, -1, "batch_id is empty");
+
+  QMutexLocker locker(&op_cancel_flags_mutex);
+  auto it = op_cancel_flags.find(event["batch_id"]);
+  if (it == op_cancel_flags.end()) {
+    CB_ERR(event, -1, "no running batch operation");
+  }
+
+  it.value()->store(true);
+  CB_SUCC(event);
+});
+
+REGISTER_EVENT_HANDLER(EMAIL_OP_CANCEL, [](const MEvent& event) -> int {
+  if (event["operation_id"].isEmpty()) {
+    CB_ERR(event, -1, "operation_id is empty");
+  }
+
+  QMutexLocker locker(&op_cancel_flags_mutex);
+  auto it = op_cancel_flags.find(event["operation_id"]);
+  if (it == op_cancel_flags.end()) {
+    CB_ERR(event, -1, "no running operation");
+  }
+
+  it.value()->store(true);
+  CB_SUCC(event);
+});
+
+// keys attached to the message go to the keyring as one buffer, decoded
+// straight from the cached parse
+REGISTER_EVENT_HANDLER(
+    EDIT_TAB_TYPE_EMAIL_OP_IMPORT_KEYS, [](const MEvent& event) -> int {
+      if (event["channel"].isEmpty()) CB_ERR(event, -1, "channel is empty");
+      if (!HasEventPayload(event, "data")) CB_ERR(event, -1, "data is empty");
+
+      auto channel = event.value("channel", "0").toInt();
+      auto data = ReadEventPayload(event, "data");
+
+      QString error_string;
+      auto parsed = ParseCachedEMLMessage(data, error_string);
+      if (parsed == nullptr) CB_ERR(event, -1, error_string);
+
+      QByteArray keys;
+      int count = 0;
+      try {
+        QMutexLocker locker(&parsed->lock);
+        count = ExtractPublicKeyAttachments(parsed->message, keys);
+      } catch (const vmime::exception& e) {
+        FLOG_DEBUG("error when extracting attached keys: %1", e.what());
+        CB_ERR(event, -1, "Error when extracting attached public keys");
+      }
+
+      if (count == 0) CB_ERR(event, -1, "no attached public keys");
+      FLOG_DEBUG("importing %1 attached public keys, size: %2", count,
+                 keys.size());
+
+      {
+        EMailGpgChannelLock lock(channel);
+        GFGpgImportKeys(channel, nullptr, keys.constData(),
+                        static_cast<int>(keys.size()));
+      }
+      EMailKeyringCache::GetInstance().Invalidate();
+      EMailVerifyIndex::GetInstance().OnKeyringChanged();
+      EMailLiveVerifier::RecheckAll();
+      CB_SUCC(event);
+    });
+
+// exported keys, UIDs and verify outcomes may have changed with the keyring
+REGISTER_EVENT_HANDLER(KEY_DATABASE_REFRESHED, [](const MEvent& event) -> int {
+  EMailKeyringCache::GetInstance().Invalidate();
+  EMailVerifyIndex::GetInstance().OnKeyringChanged();
+  EMailLiveVerifier::RecheckAll();
+  CB_SUCC(event);
+});
+
+namespace {
+
+// Runs after every REGISTER_EVENT_HANDLER above. Only handlers that never
+// touch a widget and do all their GnuPG work before the CB are wrapped. Sign,
+// encrypt and encrypt+sign create the metadata dialog and finish from its
+// signal, key import changes the keyring, the save handler talks to the
+// editor tab; those stay on the calling thread.
+const bool kAsyncEMailOpsRegistered = []() -> bool {
+  for (const auto* event_id : {
+           "EDIT_TAB_TYPE_EMAIL_OP_DECRYPT",
+           "EDIT_TAB_TYPE_EMAIL_OP_VERIFY",
+           "EDIT_TAB_TYPE_EMAIL_OP_DECRYPT_VERIFY",
+           "EMAIL_OP_ENCRYPT_PER_RECIPIENT",
+       }) {
+    auto& handler = _gr_module_event_handlers[event_id];
+    handler = AsyncEMailOp(handler);
+  }
+  return true;
+}();
+
+}  // namespace
@@ -0,0 +1,186 @@
+/**
+ * Copyright (C) 2021-2026 Saturneric <eric@bktus.com>
+ *
+ * This file is part of GpgFrontend.
+ *
+ * GpgFrontend is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GpgFrontend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GpgFrontend. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The initial version of the source code is inherited from
+ * the gpg4usb project, which is under GPL-3.0-or-later.
+ *
+ * All the source code of GpgFrontend was modified and released by
+ * Saturneric <eric@bktus.com> starting on May 12, 2021.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "EMailPGPMIMEScanner.h"
+
+#include <QByteArrayMatcher>
+#include <QCryptographicHash>
+
+#include "EMailHelper.h"
+#include "GFModuleCommonUtils.hpp"
+
+namespace {
+
+auto ParameterValue(const vmime::shared_ptr<vmime::contentTypeField>& field,
+                    const char* name) -> QByteArray {
+  auto parameter = field->findParameter(name);
+  if (!parameter) return {};
+  return QByteArray::fromStdString(parameter->getValue().getBuffer());
+}
+
+/**
+ * @brief find the body parts between the delimiter lines of boundary,
+ * starting at the end of the header block. Without a close delimiter the
+ * last part runs to the end of data.
+ *
+ * @param data
+ * @param from
+ * @param boundary
+ * @param parts
+ */
+void ScanParts(const QByteArray& data, qsizetype from,
+               const QByteArray& boundary,
+               QList<QPair<qsizetype, qsizetype>>& parts) {
+  // a delimiter is "--" boundary at the start of a line (RFC 2046 5.1.1)
+  const QByteArrayMatcher matcher("\n--" + boundary);
+  const auto delimiter_size = boundary.size() + 3;
+
+  qsizetype part_begin = -1;
+  for (auto pos = matcher.indexIn(data, from); pos >= 0;
+       pos = matcher.indexIn(data, pos + 1)) {
+    auto end = pos + delimiter_size;
+    const bool close = data.mid(end, 2) == "--";
+    if (close) end += 2;
+
+    // only transport padding may follow the boundary on its line
+    while (end < data.size() && (data[end] == ' ' || data[end] == '\t')) end++;
+    if (end < data.size() && data[end] != '\r' && data[end] != '\n') continue;
+
+    if (part_begin >= 0) {
+      // the line break before the delimiter belongs to the delimiter
+      auto part_end = pos;
+      if (part_end > part_begin && data[part_end - 1] == '\r') part_end--;
+      parts.append({part_begin, part_end - part_begin});
+    }
+
+    if (close) return;
+
+    if (end < data.size() && data[end] == '\r') end++;
+    part_begin = end + 1;
+  }
+
+  // as in vmime, a missing close delimiter ends the last part with the data
+  if (part_begin < 0) return;
+  part_begin = qMin(part_begin, data.size());
+  auto part_end = data.size();
+  if (part_end > part_begin && data[part_end - 1] == '\n') part_end--;
+  if (part_end > part_begin && data[part_end - 1] == '\r') part_end--;
+  parts.append({part_begin, part_end - part_begin});
+}
+
+}  // namespace
+
+auto ScanPGPMIMEStructure(const QByteArray& data, EMailPGPMIMEType type,
+                          EMailPGPMIMEStructure& structure,
+                          QString& error_string) -> bool {
+  const auto header_end = FindEMLHeaderEnd(data);
+
+  vmime::shared_ptr<vmime::contentTypeField> field;
+  try {
+    auto header = vmime::make_shared<vmime::header>();
+    header->parse(vmime::string(data.constData(), header_end));
+    field = header->findField<vmime::contentTypeField>(
+        vmime::fields::CONTENT_TYPE);
+
+    auto message_id_field = header->findField(vmime::fields::MESSAGE_ID);
+    structure.message_id =
+        message_id_field
+            ? Q_SC(message_id_field->getValue()->generate()).trimmed()
+            : QString{};
+  } catch (const vmime::exception& e) {
+    FLOG_DEBUG("error when parsing eml header: %1", e.what());
+    error_string = "Error when parsing eml raw data";
+    return false;
+  }
+
+  if (!field) {
+    error_string = "Cannot get 'Content-Type' Field from header";
+    return false;
+  }
+
+  structure.content_type = Q_SC(field->getValue()->generate()).trimmed();
+  structure.protocol = ParameterValue(field, "protocol");
+  structure.micalg = ParameterValue(field, "micalg");
+  structure.boundary = ParameterValue(field, "boundary");
+
+  const bool is_signed = type == EMailPGPMIMEType::kSigned;
+  const auto* expected_type =
+      is_signed ? "multipart/signed" : "multipart/encrypted";
+  const auto* expected_protocol =
+      is_signed ? "application/pgp-signature" : "application/pgp-encrypted";
+
+  if (structure.content_type != expected_type) {
+    error_string = QString("The message is not denoted by the '%1' content "
+                           "type")
+                       .arg(expected_type);
+    return false;
+  }
+
+  if (structure.protocol != expected_protocol) {
+    error_string =
+        QString("The 'protocol' parameter MUST have a value of '%1'")
+            .arg(expected_protocol);
+    return false;
+  }
+
+  if (is_signed && !IsValidMicalgFormat(structure.micalg)) {
+    error_string =
+        "The 'micalg' parameter MUST contain exactly one hash-symbol of the "
+        "format 'pgp-<hash-identifier>'";
+    return false;
+  }
+
+  if (structure.boundary.isEmpty()) {
+    error_string = "Cannot get 'boundary' from 'Content-Type'";
+    return false;
+  }
+
+  structure.parts.clear();
+  ScanParts(data, header_end, structure.boundary, structure.parts);
+
+  if (structure.parts.size() != 2) {
+    error_string = QString("The %1 body MUST consist of exactly two parts")
+                       .arg(expected_type);
+    return false;
+  }
+
+  return true;
+}
+
+auto HashPGPMIMESignedRegion(const QByteArray& data,
+                             const EMailPGPMIMEStructure& structure)
+    -> QByteArray {
+  QCryptographicHash hash(QCryptographicHash::Sha256);
+  hash.addData(structure.micalg.toUtf8());
+  hash.addData(structure.protocol.toUtf8());
+  for (const auto& part : structure.parts) {
+    hash.addData(
+        QByteArray::fromRawData(data.constData() + part.first, part.second));
+  }
+  return hash.result();
+}
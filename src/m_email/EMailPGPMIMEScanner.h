@@ -0,0 +1,89 @@
+/**
+ * Copyright (C) 2021-2026 Saturneric <eric@bktus.com>
+ *
+ * This file is part of GpgFrontend.
+ *
+ * GpgFrontend is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GpgFrontend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GpgFrontend. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The initial version of the source code is inherited from
+ * the gpg4usb project, which is under GPL-3.0-or-later.
+ *
+ * All the source code of GpgFrontend was modified and released by
+ * Saturneric <eric@bktus.com> starting on May 12, 2021.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+#include <QString>
+
+/**
+ * @brief the two PGP/MIME layouts of RFC 3156
+ *
+ */
+enum class EMailPGPMIMEType {
+  kSigned,
+  kEncrypted,
+};
+
+/**
+ * @brief top-level layout of a PGP/MIME message as found by
+ * ScanPGPMIMEStructure
+ *
+ */
+struct EMailPGPMIMEStructure {
+  QString content_type;
+  QString protocol;
+  QString micalg;
+  QByteArray boundary;
+  QString message_id;  ///< empty if the header has none
+
+  // offset and length of each body part, delimiter lines excluded
+  QList<QPair<qsizetype, qsizetype>> parts;
+};
+
+/**
+ * @brief Check the RFC 3156 structure of a message from its top-level header
+ * and boundary lines only, without building a vmime object graph. Messages
+ * that fail here would be rejected after the full parse as well, so the
+ * parse can be skipped for them.
+ *
+ * @param data
+ * @param type
+ * @param structure
+ * @param error_string
+ * @return true
+ * @return false
+ */
+auto ScanPGPMIMEStructure(const QByteArray& data, EMailPGPMIMEType type,
+                          EMailPGPMIMEStructure& structure,
+                          QString& error_string) -> bool;
+
+/**
+ * @brief SHA-256 over what a multipart/signed signature depends on: micalg,
+ * protocol and both body parts, at the offsets found by the scanner. Edits
+ * to the top-level header outside the Content-Type leave it unchanged.
+ *
+ * @param data
+ * @param structure a structure ScanPGPMIMEStructure accepted for data
+ * @return QByteArray
+ */
+auto HashPGPMIMESignedRegion(const QByteArray& data,
+                             const EMailPGPMIMEStructure& structure)
+    -> QByteArray;
@@ -0,0 +1,282 @@
+/**
+ * Copyright (C) 2021-2026 Saturneric <eric@bktus.com>
+ *
+ * This file is part of GpgFrontend.
+ *
+ * GpgFrontend is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GpgFrontend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GpgFrontend. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The initial version of the source code is inherited from
+ * the gpg4usb project, which is under GPL-3.0-or-later.
+ *
+ * All the source code of GpgFrontend was modified and released by
+ * Saturneric <eric@bktus.com> starting on May 12, 2021.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#include "EMailVerifyIndex.h"
+
+#include <GFSDKGpg.h>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+
+#include "EMailGpgChannel.h"
+#include "GFModuleCommonUtils.hpp"
+
+namespace {
+
+constexpr const char* kCacheKey = "email_verify_index";
+
+// the channel is the first field of EMailVerifyIndex::Key()
+auto ChannelOf(const QString& key) -> int {
+  return key.section(':', 0, 0).toInt();
+}
+
+// Snapshot of the signer's key in the keyring: a new subkey, revocation or
+// user id changes the export. Empty when the key is gone.
+auto SignerKeyHash(int channel, const QString& fpr) -> QString {
+  if (fpr.isEmpty()) return {};
+
+  const auto key = UDUP(WithGpgChannel(
+      channel, [&]() { return GFGpgPublicKey(channel, QDUP(fpr), 1); }));
+  if (key.isEmpty()) return {};
+
+  return QString::fromLatin1(
+      QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha256)
+          .toHex());
+}
+
+auto ToJson(const EMailVerifyIndexEntry& e) -> QJsonObject {
+  return {
+      {"result_status", e.result_status},
+      {"verified", e.verified},
+      {"result_detail", e.result_detail},
+      {"result_cards", e.result_cards},
+      {"signer_fpr", e.signer_fpr},
+      {"signer_key_hash", e.signer_key_hash},
+      {"micalg", e.micalg},
+      {"mime_hash", e.mime_hash},
+      {"key_state", QString::number(e.key_state)},
+      {"verified_at", QString::number(e.verified_at)},
+  };
+}
+
+auto FromJson(const QJsonObject& o) -> EMailVerifyIndexEntry {
+  EMailVerifyIndexEntry e;
+  e.result_status = o["result_status"].toInt(-1);
+  e.verified = o["verified"].toBool();
+  e.result_detail = o["result_detail"].toString();
+  e.result_cards = o["result_cards"].toString();
+  e.signer_fpr = o["signer_fpr"].toString();
+  e.signer_key_hash = o["signer_key_hash"].toString();
+  e.micalg = o["micalg"].toString();
+  e.mime_hash = o["mime_hash"].toString();
+  e.key_state = o["key_state"].toString().toLongLong();
+  e.verified_at = o["verified_at"].toString().toLongLong();
+  return e;
+}
+
+}  // namespace
+
+auto EMailVerifyIndex::GetInstance() -> EMailVerifyIndex& {
+  static EMailVerifyIndex instance;
+  return instance;
+}
+
+EMailVerifyIndex::EMailVerifyIndex()
+    : key_state_(QDateTime::currentMSecsSinceEpoch()) {
+  save_pool_.setMaxThreadCount(1);
+  load();
+}
+
+auto EMailVerifyIndex::Key(int channel, const QByteArray& data,
+                           const EMailPGPMIMEStructure& structure) -> QString {
+  // one multi-arg call, a Message-ID may itself contain "%<n>"
+  const auto hash = HashPGPMIMESignedRegion(data, structure).toHex();
+  return QString("%1:%2:%3")
+      .arg(QString::number(channel), structure.message_id,
+           QString::fromLatin1(hash));
+}
+
+auto EMailVerifyIndex::Lookup(const QString& key, EMailVerifyIndexEntry& entry)
+    -> bool {
+  const auto now = QDateTime::currentMSecsSinceEpoch();
+  qint64 key_state;
+  {
+    QMutexLocker locker(&mutex_);
+    auto it = entries_.constFind(key);
+    if (it == entries_.constEnd() || now - it->verified_at > kMaxAge) {
+      return false;
+    }
+
+    entry = *it;
+    key_state = key_state_;
+    if (entry.key_state == key_state) return true;
+  }
+
+  // recorded in an earlier session, the keyring may have changed since
+  const auto hash = SignerKeyHash(ChannelOf(key), entry.signer_fpr);
+
+  QMutexLocker locker(&mutex_);
+  auto it = entries_.find(key);
+  if (it == entries_.end() || it->key_state != entry.key_state) return false;
+  if (hash.isEmpty() || hash != entry.signer_key_hash) {
+    entries_.erase(it);
+    return false;
+  }
+
+  // the keyring changed while the signer's key was exported
+  if (key_state != key_state_) return false;
+
+  it->key_state = key_state_;
+  entry.key_state = key_state_;
+  return true;
+}
+
+void EMailVerifyIndex::Record(const QString& key,
+                              EMailVerifyIndexEntry entry) {
+  entry.signer_key_hash.clear();
+  entry.verified_at = QDateTime::currentMSecsSinceEpoch();
+
+  QMutexLocker locker(&mutex_);
+  entry.key_state = key_state_;
+  entries_.insert(key, std::move(entry));
+  evict();
+
+  if (++unsaved_ >= kSaveEvery) schedule_save();
+}
+
+void EMailVerifyIndex::OnKeyringChanged() {
+  QMutexLocker locker(&mutex_);
+  key_state_ = std::max(key_state_ + 1, QDateTime::currentMSecsSinceEpoch());
+  entries_.clear();
+  schedule_save();
+}
+
+void EMailVerifyIndex::Save() {
+  save_pool_.waitForDone();
+
+  {
+    QMutexLocker locker(&mutex_);
+    if (unsaved_ == 0) return;
+    unsaved_ = 0;
+  }
+  persist();
+}
+
+void EMailVerifyIndex::load() {
+  const auto cache = UDUP(GFDurableCacheGet(DUP(kCacheKey)));
+  const auto root = QJsonDocument::fromJson(cache.toUtf8()).object();
+
+  // outcomes without a signer cannot be checked against the keyring later
+  const auto now = QDateTime::currentMSecsSinceEpoch();
+  const auto entries = root["entries"].toObject();
+  for (auto it = entries.begin(); it != entries.end(); ++it) {
+    auto entry = FromJson(it.value().toObject());
+    if (entry.signer_key_hash.isEmpty()) continue;
+    if (now - entry.verified_at > kMaxAge) continue;
+    entries_.insert(it.key(), entry);
+  }
+
+  FLOG_DEBUG("email verify index loaded, entries: %1", entries_.size());
+}
+
+void EMailVerifyIndex::schedule_save() {
+  // the caller holds mutex_; serializing thousands of entries is left to
+  // the save thread, which only copies the implicitly shared hash
+  unsaved_ = 0;
+  if (save_scheduled_) return;
+  save_scheduled_ = true;
+
+  save_pool_.start([this]() {
+    {
+      QMutexLocker locker(&mutex_);
+      save_scheduled_ = false;
+    }
+    persist();
+  });
+}
+
+void EMailVerifyIndex::persist() {
+  QHash<QString, EMailVerifyIndexEntry> snapshot;
+  qint64 key_state;
+  {
+    QMutexLocker locker(&mutex_);
+    snapshot = entries_;  // implicitly shared, the copy is cheap
+    key_state = key_state_;
+  }
+
+  // An entry is only worth keeping for a later session with the hash of its
+  // signer's key. It is computed here, once per signer, so verifying never
+  // waits for the export.
+  QHash<QString, QString> signer_hashes;
+  QHash<QString, EMailVerifyIndexEntry> hashed;
+  for (auto it = snapshot.begin(); it != snapshot.end(); ++it) {
+    if (!it->signer_key_hash.isEmpty() || it->signer_fpr.isEmpty()) continue;
+
+    const auto channel = ChannelOf(it.key());
+    const auto signer = QString("%1:%2").arg(channel).arg(it->signer_fpr);
+    if (!signer_hashes.contains(signer)) {
+      signer_hashes.insert(signer, SignerKeyHash(channel, it->signer_fpr));
+    }
+    it->signer_key_hash = signer_hashes.value(signer);
+    hashed.insert(it.key(), *it);
+  }
+
+  {
+    QMutexLocker locker(&mutex_);
+    // the hashes may describe the old keyring, the save OnKeyringChanged()
+    // scheduled writes the new state
+    if (key_state != key_state_) return;
+
+    for (auto it = hashed.constBegin(); it != hashed.constEnd(); ++it) {
+      auto entry = entries_.find(it.key());
+      if (entry != entries_.end() && entry->verified_at == it->verified_at) {
+        entry->signer_key_hash = it->signer_key_hash;
+      }
+    }
+  }
+
+  QJsonObject entries;
+  for (auto it = snapshot.constBegin(); it != snapshot.constEnd(); ++it) {
+    if (it->signer_key_hash.isEmpty()) continue;
+    entries.insert(it.key(), ToJson(it.value()));
+  }
+
+  QJsonObject root{{"entries", entries}};
+  GFDurableCacheSave(DUP(kCacheKey),
+                     DUP(QJsonDocument(root).toJson(QJsonDocument::Compact)));
+}
+
+void EMailVerifyIndex::evict() {
+  if (entries_.size() <= kMaxEntries) return;
+
+  // drop the oldest quarter at once rather than one entry per insert
+  QList<qint64> times;
+  times.reserve(entries_.size());
+  for (const auto& e : entries_) times.append(e.verified_at);
+  auto nth = times.begin() + kMaxEntries / 4;
+  std::nth_element(times.begin(), nth, times.end());
+  const auto cutoff = *nth;
+
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    it = it->verified_at <= cutoff ? entries_.erase(it) : std::next(it);
+  }
+}
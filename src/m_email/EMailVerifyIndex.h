@@ -0,0 +1,143 @@
+/**
+ * Copyright (C) 2021-2026 Saturneric <eric@bktus.com>
+ *
+ * This file is part of GpgFrontend.
+ *
+ * GpgFrontend is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GpgFrontend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GpgFrontend. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * The initial version of the source code is inherited from
+ * the gpg4usb project, which is under GPL-3.0-or-later.
+ *
+ * All the source code of GpgFrontend was modified and released by
+ * Saturneric <eric@bktus.com> starting on May 12, 2021.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+
+#include "EMailPGPMIMEScanner.h"
+
+struct EMailVerifyIndexEntry {
+  int result_status = -1;
+  bool verified = false;  ///< the signature checked out
+  QString result_detail;
+  QString result_cards;  ///< JSON array from GFAnalyseVerifyResultByCapsule
+  QString signer_fpr;  ///< from the verify result, empty unless one signer
+  QString signer_key_hash;  ///< SHA-256 of the signer's exported key, filled
+                            ///< in when the entry is persisted
+  QString micalg;
+  QString mime_hash;
+  qint64 key_state = 0;  ///< keyring state the outcome was computed against
+  qint64 verified_at = 0;
+};
+
+/**
+ * @brief Verify outcomes of messages seen before, keyed by channel,
+ * Message-ID and the hash of the signed region, and kept across sessions in
+ * the durable cache.
+ *
+ * Every session starts a new key state. Within a session an entry stays
+ * valid until the keyring changes; OnKeyringChanged() moves the index to a
+ * new key state and drops everything recorded before. An entry from an
+ * earlier session is only answered while its signer's exported public key
+ * is unchanged, which is checked on its first hit. No entry is answered
+ * once it is older than kMaxAge, since a key expiring does not change its
+ * export.
+ */
+class EMailVerifyIndex {
+ public:
+  /**
+   * @brief Get the Instance object, loading the persisted index on first use
+   *
+   * @return EMailVerifyIndex&
+   */
+  static auto GetInstance() -> EMailVerifyIndex&;
+
+  /**
+   * @brief index key of a message, built from the scan the verify path does
+   * anyway
+   *
+   * @param channel
+   * @param data
+   * @param structure a multipart/signed structure ScanPGPMIMEStructure
+   * accepted for data
+   * @return QString
+   */
+  static auto Key(int channel, const QByteArray& data,
+                  const EMailPGPMIMEStructure& structure) -> QString;
+
+  /**
+   * @brief the outcome recorded for key, see the class comment for when an
+   * entry is still trusted
+   *
+   * @param key
+   * @param entry
+   * @return true
+   * @return false
+   */
+  auto Lookup(const QString& key, EMailVerifyIndexEntry& entry) -> bool;
+
+  /**
+   * @brief remember an outcome, stamped with the current key state. No
+   * GnuPG call is made here; the index is written in the background every
+   * kSaveEvery records.
+   *
+   * @param key
+   * @param entry
+   */
+  void Record(const QString& key, EMailVerifyIndexEntry entry);
+
+  /**
+   * @brief start a new key state, dropping every recorded outcome
+   *
+   */
+  void OnKeyringChanged();
+
+  /**
+   * @brief write the index to the durable cache if it changed, waiting for
+   * a background write still running
+   *
+   */
+  void Save();
+
+ private:
+  EMailVerifyIndex();
+
+  void load();
+
+  void schedule_save();
+
+  void persist();
+
+  void evict();
+
+  QMutex mutex_;
+  QHash<QString, EMailVerifyIndexEntry> entries_;
+  qint64 key_state_ = 0;
+  int unsaved_ = 0;
+  bool save_scheduled_ = false;
+  QThreadPool save_pool_;  ///< last, so it is drained before the rest goes
+
+  static constexpr int kMaxEntries = 4096;
+  static constexpr int kSaveEvery = 64;
+  static constexpr qint64 kMaxAge = 24LL * 60 * 60 * 1000;
+};